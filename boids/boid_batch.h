@@ -0,0 +1,188 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "SDL2/SDL.h"
+
+// Midpoint circle, f(dx, dy) is called with every outline offset from the centre
+template <typename F>
+void ForEachCirclePoint(int32_t radius, F f)
+{
+  const int32_t diameter = (radius * 2);
+
+  int32_t x = (radius - 1);
+  int32_t y = 0;
+  int32_t tx = 1;
+  int32_t ty = 1;
+  int32_t error = (tx - diameter);
+
+  while (x >= y)
+  {
+      //  Each of the following renders an octant of the circle
+      f(x, -y);
+      f(x, y);
+      f(-x, -y);
+      f(-x, y);
+      f(y, -x);
+      f(y, x);
+      f(-y, -x);
+      f(-y, x);
+
+      if (error <= 0)
+      {
+        ++y;
+        error += ty;
+        ty += 2;
+      }
+
+      if (error > 0)
+      {
+        --x;
+        tx += 2;
+        error += (tx - diameter);
+      }
+  }
+}
+
+// Draws a whole flock with a single call. The boid outline is rasterised once
+// into a small texture, next to one solid texel used for the heading lines,
+// and every frame only the vertices are rebuilt into reused buffers.
+class BoidBatch
+{
+public:
+  BoidBatch(SDL_Renderer* renderer, int32_t radius, SDL_Color color)
+    : mRadius(radius)
+    , mColor(color)
+  {
+    // Outline spans [-(radius - 1), radius - 1], the last column holds the solid texel
+    const int32_t size = 2 * radius - 1;
+    mGlyphWidth = size + 2;
+    mGlyphHeight = size;
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    std::vector<uint32_t> pixels(mGlyphWidth * mGlyphHeight, 0);
+    ForEachCirclePoint(radius, [&](int32_t dx, int32_t dy)
+    {
+      pixels[(radius - 1 + dy) * mGlyphWidth + radius - 1 + dx] = 0xFFFFFFFF;
+    });
+    pixels[mGlyphWidth - 1] = 0xFFFFFFFF;
+
+    mGlyph = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC, mGlyphWidth, mGlyphHeight);
+    SDL_UpdateTexture(mGlyph, nullptr, pixels.data(), mGlyphWidth * sizeof(uint32_t));
+    SDL_SetTextureBlendMode(mGlyph, SDL_BLENDMODE_BLEND);
+#else
+    ForEachCirclePoint(radius, [&](int32_t dx, int32_t dy) { mOutline.push_back({dx, dy}); });
+#endif
+  }
+
+  ~BoidBatch()
+  {
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    SDL_DestroyTexture(mGlyph);
+#endif
+  }
+
+  BoidBatch(const BoidBatch&) = delete;
+  BoidBatch& operator=(const BoidBatch&) = delete;
+
+  void Clear()
+  {
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    mVertices.clear();
+#else
+    mPoints.clear();
+    mLines.clear();
+#endif
+  }
+
+  // Boid at (x, y) heading towards (x, y) + (vx, vy) * length
+  void Add(float x, float y, float vx, float vy, float length)
+  {
+    // Same truncation as the per point path so both look identical
+    const int32_t cx = x;
+    const int32_t cy = y;
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    const float left = cx - (mRadius - 1);
+    const float top = cy - (mRadius - 1);
+    const float size = 2 * mRadius - 1;
+    const float u = float(mGlyphWidth - 2) / mGlyphWidth;
+    Quad({left, top}, {left + size, top}, {left + size, top + size}, {left, top + size}, 0, 0, u, 1);
+
+    // One pixel wide quad through the pixel centres along the heading,
+    // textured with the solid texel
+    const float sx = cx + 0.5f, sy = cy + 0.5f;
+    const float ex = int32_t(x + vx * length) + 0.5f;
+    const float ey = int32_t(y + vy * length) + 0.5f;
+    const float dx = ex - sx, dy = ey - sy;
+    const float magnitude = std::sqrt(dx * dx + dy * dy);
+    if (magnitude > 0)
+    {
+      const float nx = -dy / magnitude * 0.5f;
+      const float ny = dx / magnitude * 0.5f;
+      const float s = (mGlyphWidth - 0.5f) / mGlyphWidth;
+      const float t = 0.5f / mGlyphHeight;
+      Quad({sx + nx, sy + ny}, {ex + nx, ey + ny}, {ex - nx, ey - ny}, {sx - nx, sy - ny}, s, t, s, t);
+    }
+#else
+    for (const auto& offset : mOutline)
+      mPoints.push_back({cx + offset.x, cy + offset.y});
+    mLines.push_back({cx, cy, int32_t(x + vx * length), int32_t(y + vy * length)});
+#endif
+  }
+
+  void Draw(SDL_Renderer* renderer)
+  {
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    // Indices repeat the same two triangles per quad, only extend them when the flock grows
+    while (mIndices.size() / 6 < mVertices.size() / 4)
+    {
+      const int first = mIndices.size() / 6 * 4;
+      for (int i : {0, 1, 2, 0, 2, 3})
+        mIndices.push_back(first + i);
+    }
+
+    SDL_RenderGeometry(renderer, mGlyph, mVertices.data(), mVertices.size(), mIndices.data(), mVertices.size() / 4 * 6);
+#else
+    // Older SDL has no geometry call, still send all outlines at once
+    SDL_SetRenderDrawColor(renderer, mColor.r, mColor.g, mColor.b, mColor.a);
+    SDL_RenderDrawPoints(renderer, mPoints.data(), mPoints.size());
+    for (const auto& line : mLines)
+      SDL_RenderDrawLine(renderer, line.x0, line.y0, line.x1, line.y1);
+#endif
+  }
+
+private:
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+  void Quad(SDL_FPoint a, SDL_FPoint b, SDL_FPoint c, SDL_FPoint d, float u0, float v0, float u1, float v1)
+  {
+    mVertices.push_back({a, mColor, {u0, v0}});
+    mVertices.push_back({b, mColor, {u1, v0}});
+    mVertices.push_back({c, mColor, {u1, v1}});
+    mVertices.push_back({d, mColor, {u0, v1}});
+  }
+#endif
+
+  const int32_t mRadius;
+  const SDL_Color mColor;
+
+  int32_t mGlyphWidth;
+  int32_t mGlyphHeight;
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+  SDL_Texture* mGlyph = nullptr;
+  std::vector<SDL_Vertex> mVertices;
+  std::vector<int> mIndices;
+#else
+  struct Line
+  {
+    int32_t x0, y0, x1, y1;
+  };
+
+  std::vector<SDL_Point> mOutline;
+  std::vector<SDL_Point> mPoints;
+  std::vector<Line> mLines;
+#endif
+};
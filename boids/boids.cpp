@@ -1,323 +1,65 @@
 #include "logging.h"
 #include "linalg.h"
+#include "boid_batch.h"
+#include "boid_swarm.h"
+#include "boids.h"
+#include "headless.h"
 
+#include <cstring>
 #include <random>
 
 #include "SDL2/SDL.h"
 #include <SDL_ttf.h>
 
-#define WIDTH 640
-#define HEIGHT 480
 #define FPS 60
 #define SIZE 5
-#define BOIDS 100
+#define SWARM true
+#define BATCHED true
+#define STEPS 1000
 
 TTF_Font* font;
 
-double ToroidalDistance (linalg::Double2d p1, linalg::Double2d p2, int width, int height)
+void DrawCircle(SDL_Renderer* renderer, int32_t centreX, int32_t centreY, int32_t radius)
 {
-  float dx = std::abs(p2.X() - p1.X());
-  float dy = std::abs(p2.Y() - p1.Y());
-
-  if (dx > width / 2)
-      dx = width - dx;
-
-  if (dy > height / 2)
-      dy = height - dy;
-
-  return std::sqrt(dx * dx + dy * dy);
+  ForEachCirclePoint(radius, [&](int32_t dx, int32_t dy)
+  {
+    SDL_RenderDrawPoint(renderer, centreX + dx, centreY + dy);
+  });
 }
 
-class Boid
+void Draw(SDL_Renderer* renderer, const Boids& boids)
 {
-public:
-  // Start with a random position in the screen
-  Boid(uint32_t id)
-    : mId(id)
-  {
-    mPos = linalg::Double2d(rand() % WIDTH, rand() % HEIGHT);
-
-    double angle = double(rand() % 314) / 100;
-    mVel = linalg::Double2d(rand() % (int)mMaxSpeed + 1, angle, linalg::Format::Polar);
-  }
-
-  uint32_t Id() const
-  {
-    return mId;
-  }
-
-  linalg::Double2d Position() const
-  {
-    return mPos;
-  }
-
-  linalg::Double2d Velocity() const
-  {
-    return mVel;
-  }
-
-  void UpdateMultipliers(double a, double s, double c)
-  {
-    aMultiplier = a;
-    sMultiplier = s;
-    cMultiplier = c;
-  }
-
-  linalg::Double2d Alignment(const std::vector<Boid>& boids) const
-  {
-    int counted = 0;
-    linalg::Double2d avg;
-
-    for (const auto& b : boids)
-    {
-      if (b.Id() == Id())
-        continue;
-
-      if (mPos.Distance(b.Position()) >= mRadius)
-        continue;
-
-      avg += b.Velocity();
-      ++counted;
-    }
-
-    if (counted > 0)
-    {
-      avg /= counted;
-      avg.SetMagnitude(mMaxSpeed);
-      avg -= Velocity();
-      avg.Limit(mMaxForce);
-    }
-
-    return avg;
-  }
-
-  linalg::Double2d Separation(const std::vector<Boid>& boids) const
-  {
-    int counted = 0;
-    double radius = 70;
-    linalg::Double2d avg;
-
-    for (const auto& b : boids)
-    {
-      if (b.Id() == Id())
-        continue;
-
-      auto distance = mPos.Distance(b.Position());
-      if (distance >= radius || distance < 0.01)
-        continue;
-
-      auto diff = Position() - b.Position();
-      diff /= distance * distance;
-
-      avg += diff;
-      ++counted;
-    }
-
-    if (counted > 0)
-    {
-      avg /= counted;
-      avg.SetMagnitude(mMaxSpeed);
-      avg -= Velocity();
-      avg.Limit(mMaxForce);
-    }
-
-    return avg;
-  }
-
-  linalg::Double2d Cohesion(const std::vector<Boid>& boids) const
-  {
-    int counted = 0;
-    double radius = 100;
-    linalg::Double2d avg;
-
-    for (const auto& b : boids)
-    {
-      if (b.Id() == Id())
-        continue;
-
-      if (mPos.Distance(b.Position()) >= radius)
-        continue;
-
-      avg += b.Position();
-      ++counted;
-    }
-
-    if (counted > 0)
-    {
-      avg /= counted;
-      avg -= Position();
-      avg.SetMagnitude(mMaxSpeed);
-      avg -= Velocity();
-      avg.Limit(mMaxForce);
-    }
-
-    return avg;
-  }
-
-  linalg::Double2d Combined(const std::vector<Boid>& boids) const
-  {
-    int counted = 0;
-    linalg::Double2d avgAlignment, avgSeparation, avgCohesion;
-
-    for (const auto& b : boids)
-    {
-      if (b.Id() == Id())
-        continue;
-
-      auto distance = ToroidalDistance(mPos, b.Position(), WIDTH, HEIGHT);  // mPos.Distance(b.Position());
-      if (distance >= mRadius || distance < 0.01)
-        continue;
-
-      // Alignment
-      avgAlignment += b.Velocity();
-
-      // Separation
-      auto diff = Position() - b.Position();
-      diff /= distance * distance;
-      avgSeparation += diff;
-
-      // Cohesion
-      avgCohesion += b.Position();
-
-      ++counted;
-    }
-
-    if (counted > 0)
-    {
-      // Alignment
-      avgAlignment /= counted;
-      avgAlignment.SetMagnitude(mMaxSpeed);
-      avgAlignment -= Velocity();
-      avgAlignment.Limit(mMaxForce);
-
-      // Separation
-      avgSeparation /= counted;
-      avgSeparation.SetMagnitude(mMaxSpeed);
-      avgSeparation -= Velocity();
-      avgSeparation.Limit(mMaxForce);
-
-      avgCohesion /= counted;
-      avgCohesion -= Position();
-      avgCohesion.SetMagnitude(mMaxSpeed);
-      avgCohesion -= Velocity();
-      avgCohesion.Limit(mMaxForce);
-    }
-
-    return (avgAlignment * aMultiplier) + (avgSeparation * sMultiplier) + (avgCohesion * cMultiplier);
-  }
-
-  void Boundaries(linalg::Double2d& p)
-  {
-    if (p.X() < 0)
-      p[0] = WIDTH;
-    else if (p.X() > WIDTH)
-      p[0] = 0;
-
-    if (p.Y() < 0)
-      p[1] = HEIGHT;
-    else if (p.Y() > HEIGHT)
-      p[1] = 0;
-  }
-
-  void Update(const std::vector<Boid>& boids)
-  {
-    linalg::Double2d acceleration = Combined(boids);
-
-    linalg::Double2d p = mPos + mVel;
-
-    mVel += acceleration;
-    mVel.Limit(mMaxSpeed);
-
-    Boundaries(p);
-
-    mPos = p;
-  }
-
-  void Draw(SDL_Renderer* renderer)
+  for (const auto& boid : boids.All())
   {
-    auto p1 = mPos + (mVel * SIZE);
-    DrawCircle(renderer, mPos.X(), mPos.Y(), SIZE);
-    SDL_RenderDrawLine(renderer, mPos.X(), mPos.Y(), p1.X(), p1.Y());
-  }
-
-  void DrawCircle(SDL_Renderer* renderer, int32_t centreX, int32_t centreY, int32_t radius)
-  {
-    const int32_t diameter = (radius * 2);
-
-    int32_t x = (radius - 1);
-    int32_t y = 0;
-    int32_t tx = 1;
-    int32_t ty = 1;
-    int32_t error = (tx - diameter);
-
-    while (x >= y)
-    {
-        //  Each of the following renders an octant of the circle
-        SDL_RenderDrawPoint(renderer, centreX + x, centreY - y);
-        SDL_RenderDrawPoint(renderer, centreX + x, centreY + y);
-        SDL_RenderDrawPoint(renderer, centreX - x, centreY - y);
-        SDL_RenderDrawPoint(renderer, centreX - x, centreY + y);
-        SDL_RenderDrawPoint(renderer, centreX + y, centreY - x);
-        SDL_RenderDrawPoint(renderer, centreX + y, centreY + x);
-        SDL_RenderDrawPoint(renderer, centreX - y, centreY - x);
-        SDL_RenderDrawPoint(renderer, centreX - y, centreY + x);
-
-        if (error <= 0)
-        {
-          ++y;
-          error += ty;
-          ty += 2;
-        }
-
-        if (error > 0)
-        {
-          --x;
-          tx += 2;
-          error += (tx - diameter);
-        }
-    }
+    auto p = boid.Position();
+    auto p1 = p + (boid.Velocity() * SIZE);
+    DrawCircle(renderer, p.X(), p.Y(), SIZE);
+    SDL_RenderDrawLine(renderer, p.X(), p.Y(), p1.X(), p1.Y());
   }
+}
 
-private:
-  uint32_t mId;
-  uint32_t mRadius = 100;
-
-  double mMaxSpeed = 3;
-  double mMaxForce = 0.2;
-
-  double aMultiplier, sMultiplier, cMultiplier;
-
-  linalg::Double2d mPos, mVel;
-};
-
-class Boids
+void Draw(SDL_Renderer* renderer, const BoidSwarm& swarm)
 {
-public:
-  Boids(){};
-
-  void AddBoid()
-  {
-    mBoids.push_back(Boid(mBoids.size()));
-  }
-
-  void Update(double a, double s, double c)
+  for (size_t i = 0; i < swarm.Size(); ++i)
   {
-    for (auto& boid : mBoids)
-    {
-      boid.UpdateMultipliers(a, s, c);
-      boid.Update(mBoids);
-    }
+    DrawCircle(renderer, swarm.X(i), swarm.Y(i), SIZE);
+    SDL_RenderDrawLine(renderer, swarm.X(i), swarm.Y(i), swarm.X(i) + swarm.Vx(i) * SIZE, swarm.Y(i) + swarm.Vy(i) * SIZE);
   }
+}
 
-  void Draw(SDL_Renderer* renderer)
-  {
-    for (auto& boid : mBoids)
-      boid.Draw(renderer);
-  }
+void Draw(BoidBatch& batch, const Boids& boids)
+{
+  batch.Clear();
+  for (const auto& boid : boids.All())
+    batch.Add(boid.Position().X(), boid.Position().Y(), boid.Velocity().X(), boid.Velocity().Y(), SIZE);
+}
 
-private:
-  std::vector<Boid> mBoids;
-};
+void Draw(BoidBatch& batch, const BoidSwarm& swarm)
+{
+  batch.Clear();
+  for (size_t i = 0; i < swarm.Size(); ++i)
+    batch.Add(swarm.X(i), swarm.Y(i), swarm.Vx(i), swarm.Vy(i), SIZE);
+}
 
 // TODO: Move to SDL plugin library
 void PrintText(SDL_Renderer* renderer, SDL_Rect dest, const std::string& text)
@@ -391,10 +133,74 @@ private:
   int mCurrentValue;
 };
 
-int main()
+struct Options
 {
-  srand(time(NULL));
+  bool headless = false;
+  bool swarm = SWARM;
+  bool batched = BATCHED;
+  uint32_t count = BOIDS_COUNT;
+  uint32_t steps = STEPS;
+  uint32_t seed = time(NULL);
+  unsigned threads = 0;
+};
 
+void PrintUsage(const char* name)
+{
+  printf("Usage: %s [--headless] [--count N] [--steps N] [--seed N] [--threads N] [--backend swarm|objects] [--draw batch|points]\n", name);
+}
+
+bool ParseOptions(int argc, char* argv[], Options& options)
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+    if (!strcmp(argv[i], "--headless"))
+    {
+      options.headless = true;
+      continue;
+    }
+
+    if (!value)
+      return false;
+
+    if (!strcmp(argv[i], "--count"))
+      options.count = strtoul(value, nullptr, 10);
+    else if (!strcmp(argv[i], "--steps"))
+      options.steps = strtoul(value, nullptr, 10);
+    else if (!strcmp(argv[i], "--seed"))
+      options.seed = strtoul(value, nullptr, 10);
+    else if (!strcmp(argv[i], "--threads"))
+      options.threads = strtoul(value, nullptr, 10);
+    else if (!strcmp(argv[i], "--backend") && !strcmp(value, "swarm"))
+      options.swarm = true;
+    else if (!strcmp(argv[i], "--backend") && !strcmp(value, "objects"))
+      options.swarm = false;
+    else if (!strcmp(argv[i], "--draw") && !strcmp(value, "batch"))
+      options.batched = true;
+    else if (!strcmp(argv[i], "--draw") && !strcmp(value, "points"))
+      options.batched = false;
+    else
+      return false;
+
+    ++i;
+  }
+
+  return true;
+}
+
+// Update as fast as possible without touching SDL and report the throughput
+template <typename T>
+int RunHeadless(T& boids, const Options& options)
+{
+  printf("%s backend, %u threads, seed %u\n", options.swarm ? "swarm" : "objects", boids.Threads(), options.seed);
+  Print(Measure(boids, options.steps));
+  return 0;
+}
+
+template <typename T>
+int RunWindow(T& boids, const Options& options)
+{
   SDL_Init(SDL_INIT_VIDEO);
   TTF_Init();
 
@@ -405,30 +211,26 @@ int main()
   return -1;
 #endif
 
-  Boids boids;
-
   bool run = true;
   bool pressed = false;
 
-  Slider sAlignment(WIDTH - 80, HEIGHT - 210, 20, 200, {0, 255, 0}, "A");
-  Slider sSeparation(WIDTH - 55, HEIGHT - 210, 20, 200, {255, 0, 0}, "S");
-  Slider sCohesion(WIDTH - 30, HEIGHT - 210, 20, 200, {0, 0, 255}, "C");
+  Slider sAlignment(BOIDS_WIDTH - 80, BOIDS_HEIGHT - 210, 20, 200, {0, 255, 0}, "A");
+  Slider sSeparation(BOIDS_WIDTH - 55, BOIDS_HEIGHT - 210, 20, 200, {255, 0, 0}, "S");
+  Slider sCohesion(BOIDS_WIDTH - 30, BOIDS_HEIGHT - 210, 20, 200, {0, 0, 255}, "C");
 
   SDL_DisplayMode DM0, DM1;
   SDL_GetCurrentDisplayMode(0, &DM0);
   SDL_GetCurrentDisplayMode(1, &DM1);
 
   SDL_Window* window = SDL_CreateWindow("Boids",
-                                        DM0.w + (DM1.w - WIDTH) / 2,
-                                        (DM1.h - HEIGHT) / 2,
-                                        WIDTH,
-                                        HEIGHT,
+                                        DM0.w + (DM1.w - BOIDS_WIDTH) / 2,
+                                        (DM1.h - BOIDS_HEIGHT) / 2,
+                                        BOIDS_WIDTH,
+                                        BOIDS_HEIGHT,
                                         SDL_WINDOW_SHOWN);
 
   SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
-
-  for (int i = 0; i < BOIDS; ++i)
-    boids.AddBoid();
+  BoidBatch batch(renderer, SIZE, {255, 255, 255, 200});
 
   while (run)
   {
@@ -446,7 +248,15 @@ int main()
     SDL_RenderClear(renderer);
 
     SDL_SetRenderDrawColor(renderer, 255, 255, 255, 200);
-    boids.Draw(renderer);
+    if (options.batched)
+    {
+      Draw(batch, boids);
+      batch.Draw(renderer);
+    }
+    else
+    {
+      Draw(renderer, boids);
+    }
 
     auto a = 2 * sAlignment.Update(renderer, event);
     auto s = 2 * sSeparation.Update(renderer, event);
@@ -462,3 +272,39 @@ int main()
   SDL_Quit();
   return 0;
 }
+
+int main(int argc, char* argv[])
+{
+  Options options;
+  if (!ParseOptions(argc, argv, options))
+  {
+    PrintUsage(argv[0]);
+    return -1;
+  }
+
+  srand(options.seed);
+
+  // Headless runs keep the density of the window, however many boids there are
+  int width = BOIDS_WIDTH, height = BOIDS_HEIGHT;
+  if (options.headless)
+    WorldFor(options.count, width, height);
+
+  if (options.swarm)
+  {
+    SteeringParameters parameters;
+    parameters.radius = BOIDS_RADIUS;
+    parameters.maxSpeed = BOIDS_MAX_SPEED;
+    BoidSwarm boids(width, height, parameters, options.threads);
+
+    for (uint32_t i = 0; i < options.count; ++i)
+      boids.AddBoid();
+
+    return options.headless ? RunHeadless(boids, options) : RunWindow(boids, options);
+  }
+
+  Boids boids(width, height, options.threads);
+  for (uint32_t i = 0; i < options.count; ++i)
+    boids.AddBoid();
+
+  return options.headless ? RunHeadless(boids, options) : RunWindow(boids, options);
+}
@@ -0,0 +1,46 @@
+#include "boid_swarm.h"
+#include "boids.h"
+#include "headless.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+#define SEED 42
+#define STEPS 50
+
+// Sweep the flock size for both backends at the density of the windowed demo
+int main(int argc, char* argv[])
+{
+  const uint32_t steps = argc > 1 ? strtoul(argv[1], nullptr, 10) : STEPS;
+  const uint32_t counts[] = {1000, 10000, 50000, 100000, 200000};
+
+  printf("%8s %8s %12s %14s %10s %10s\n", "backend", "boids", "steps/s", "updates/s", "p50 ms", "p99 ms");
+
+  for (uint32_t count : counts)
+  {
+    int width, height;
+    WorldFor(count, width, height);
+
+    srand(SEED);
+    BoidSwarm swarm(width, height);
+    for (uint32_t i = 0; i < count; ++i)
+      swarm.AddBoid();
+
+    Report report = Measure(swarm, steps);
+    printf("%8s %8u %12.1f %14.3e %10.3f %10.3f\n", "swarm", count, report.stepsPerSecond, report.updatesPerSecond, report.p50, report.p99);
+
+    // The object backend is much slower, keep its sweep short
+    if (count > 50000)
+      continue;
+
+    srand(SEED);
+    Boids boids(width, height);
+    for (uint32_t i = 0; i < count; ++i)
+      boids.AddBoid();
+
+    report = Measure(boids, steps);
+    printf("%8s %8u %12.1f %14.3e %10.3f %10.3f\n", "objects", count, report.stepsPerSecond, report.updatesPerSecond, report.p50, report.p99);
+  }
+
+  return 0;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+
+// Runtime choice between kernels compiled for different instruction sets.
+// Every kernel file keeps a table of its kernels, widest first, and the first
+// one the running CPU supports is used.
+namespace cpu
+{
+
+// What an x86 kernel needs beyond the SSE2 every x86-64 CPU has. Anything
+// else, wasm simd128 included, is settled at compile time and is BASELINE.
+enum Feature
+{
+  BASELINE,
+  SSE41,
+  AVX2,
+};
+
+inline bool Supports(Feature feature)
+{
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  switch (feature)
+  {
+    case SSE41:
+      return __builtin_cpu_supports("sse4.1");
+    case AVX2:
+      return __builtin_cpu_supports("avx2");
+    default:
+      break;
+  }
+#endif
+
+  return feature == BASELINE;
+}
+
+template <typename Kernel>
+struct Option
+{
+  Feature feature;
+  const char* name;
+  Kernel kernel;
+};
+
+// First option of the table the running CPU supports, the last one has to be BASELINE
+template <typename Kernel, size_t N>
+Kernel Select(const Option<Kernel> (&options)[N], const char** name = nullptr)
+{
+  size_t i = 0;
+  while (i + 1 < N && !Supports(options[i].feature))
+    ++i;
+
+  if (name)
+    *name = options[i].name;
+  return options[i].kernel;
+}
+
+} // namespace cpu
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Read only view of a whole file, mapped so large inputs are paged in while
+// they are parsed instead of being copied first
+class MappedFile
+{
+public:
+  MappedFile(const char* path)
+  {
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0)
+      return;
+
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0)
+    {
+      void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data != MAP_FAILED)
+      {
+        madvise(data, info.st_size, MADV_SEQUENTIAL);
+        mData = static_cast<const char*>(data);
+        mSize = info.st_size;
+      }
+    }
+
+    close(fd);
+  }
+
+  ~MappedFile()
+  {
+    if (mData)
+      munmap(const_cast<char*>(mData), mSize);
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const char* Begin() const
+  {
+    return mData;
+  }
+
+  const char* End() const
+  {
+    return mData + mSize;
+  }
+
+  bool Valid() const
+  {
+    return mData != nullptr;
+  }
+
+private:
+  const char* mData = nullptr;
+  size_t mSize = 0;
+};
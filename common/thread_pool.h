@@ -0,0 +1,182 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of workers running parallel loops. A loop is cut into chunks that
+// are dealt out evenly, each worker drains its own share from the front and,
+// once empty, steals from the back of the others. The calling thread joins in
+// as worker 0, so a pool of size 1 runs everything inline.
+class ThreadPool
+{
+public:
+  using Task = std::function<void(size_t, size_t)>;
+
+  explicit ThreadPool(unsigned threads = 0)
+  {
+    if (threads == 0)
+      threads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (unsigned i = 0; i < threads; ++i)
+      mQueues.emplace_back(new Queue());
+
+    for (unsigned i = 1; i < threads; ++i)
+      mWorkers.emplace_back([this, i] { Work(i); });
+  }
+
+  ~ThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mStop = true;
+    }
+
+    mWake.notify_all();
+    for (auto& worker : mWorkers)
+      worker.join();
+  }
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  unsigned Size() const
+  {
+    return mQueues.size();
+  }
+
+  // Call task(chunkBegin, chunkEnd) over [begin, end) in chunks of at most
+  // `grain` items and return once all of them are done
+  void ParallelFor(size_t begin, size_t end, size_t grain, const Task& task)
+  {
+    if (begin >= end)
+      return;
+
+    grain = std::max<size_t>(1, grain);
+    const size_t chunks = (end - begin + grain - 1) / grain;
+
+    if (Size() == 1 || chunks == 1)
+    {
+      for (size_t b = begin; b < end; b += grain)
+        task(b, std::min(end, b + grain));
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mTask = &task;
+      mBegin = begin;
+      mEnd = end;
+      mGrain = grain;
+      mRemaining = chunks;
+
+      for (size_t q = 0; q < mQueues.size(); ++q)
+      {
+        std::lock_guard<std::mutex> queueLock(mQueues[q]->mutex);
+        mQueues[q]->next = chunks * q / mQueues.size();
+        mQueues[q]->last = chunks * (q + 1) / mQueues.size();
+      }
+
+      ++mGeneration;
+    }
+
+    mWake.notify_all();
+    Run(0);
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    mDone.wait(lock, [this] { return mRemaining == 0; });
+    mTask = nullptr;
+  }
+
+private:
+  struct Queue
+  {
+    std::mutex mutex;
+    size_t next = 0;
+    size_t last = 0;
+  };
+
+  void Work(unsigned id)
+  {
+    size_t seen = 0;
+    while (true)
+    {
+      {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mWake.wait(lock, [this, seen] { return mStop || mGeneration != seen; });
+
+        if (mStop)
+          return;
+
+        seen = mGeneration;
+      }
+
+      Run(id);
+    }
+  }
+
+  // Drain our own queue, then steal until every queue is empty
+  void Run(unsigned id)
+  {
+    size_t chunk;
+    while (Pop(id, chunk) || Steal(id, chunk))
+    {
+      const size_t b = mBegin + chunk * mGrain;
+      (*mTask)(b, std::min(mEnd, b + mGrain));
+
+      if (--mRemaining == 0)
+      {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mDone.notify_all();
+      }
+    }
+  }
+
+  bool Pop(unsigned id, size_t& chunk)
+  {
+    Queue& queue = *mQueues[id];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.next == queue.last)
+      return false;
+
+    chunk = queue.next++;
+    return true;
+  }
+
+  bool Steal(unsigned id, size_t& chunk)
+  {
+    for (size_t offset = 1; offset < mQueues.size(); ++offset)
+    {
+      Queue& queue = *mQueues[(id + offset) % mQueues.size()];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (queue.next == queue.last)
+        continue;
+
+      chunk = --queue.last;
+      return true;
+    }
+
+    return false;
+  }
+
+  std::vector<std::unique_ptr<Queue>> mQueues;
+  std::vector<std::thread> mWorkers;
+
+  std::mutex mMutex;
+  std::condition_variable mWake;
+  std::condition_variable mDone;
+  size_t mGeneration = 0;
+  bool mStop = false;
+
+  const Task* mTask = nullptr;
+  size_t mBegin = 0;
+  size_t mEnd = 0;
+  size_t mGrain = 1;
+  std::atomic<size_t> mRemaining{0};
+};
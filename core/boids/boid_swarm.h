@@ -0,0 +1,480 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#endif
+
+#include "cpu_dispatch.h"
+#include "linalg.h"
+#include "spatial_grid.h"
+#include "thread_pool.h"
+
+// Boids per parallel chunk. A vectorised step is several times cheaper than a
+// step of the object per boid flock, so chunks are larger than BOIDS_GRAIN to
+// keep the scheduling cost per boid the same, and in cell order each chunk
+// still reads a compact part of the grid.
+#define SWARM_GRAIN 1024
+
+// Steering parameters shared by every boid of a swarm
+struct SteeringParameters
+{
+  float radius = 100;
+  float minDistance = 0.01;
+  float maxSpeed = 3;
+  float maxForce = 0.2;
+
+  float alignment = 1;
+  float separation = 1;
+  float cohesion = 1;
+};
+
+// Read-only view of a swarm sorted by grid cell, as seen by the kernels
+struct SwarmView
+{
+  const float* x;
+  const float* y;
+  const float* vx;
+  const float* vy;
+
+  float width;
+  float height;
+  float radius2;
+  float minDistance2;
+};
+
+// Sums over the neighbours of one boid, see Boid::Combined
+struct Neighbourhood
+{
+  float alignmentX = 0, alignmentY = 0;
+  float separationX = 0, separationY = 0;
+  float cohesionX = 0, cohesionY = 0;
+  float counted = 0;
+};
+
+using SwarmKernel = void (*)(const SwarmView&, float, float, uint32_t, uint32_t, Neighbourhood&);
+
+inline void AccumulateScalar(const SwarmView& v, float px, float py, uint32_t begin, uint32_t end, Neighbourhood& n)
+{
+  for (uint32_t j = begin; j < end; ++j)
+  {
+    const float rx = px - v.x[j];
+    const float ry = py - v.y[j];
+
+    const float dx = std::min(std::abs(rx), v.width - std::abs(rx));
+    const float dy = std::min(std::abs(ry), v.height - std::abs(ry));
+    const float d2 = dx * dx + dy * dy;
+
+    if (d2 >= v.radius2 || d2 < v.minDistance2)
+      continue;
+
+    n.alignmentX += v.vx[j];
+    n.alignmentY += v.vy[j];
+    n.separationX += rx / d2;
+    n.separationY += ry / d2;
+    n.cohesionX += v.x[j];
+    n.cohesionY += v.y[j];
+    n.counted += 1;
+  }
+}
+
+#if defined(__x86_64__)
+inline float HorizontalSum(__m128 v)
+{
+  __m128 shuffled = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+  __m128 sums = _mm_add_ps(v, shuffled);
+  shuffled = _mm_movehl_ps(shuffled, sums);
+  return _mm_cvtss_f32(_mm_add_ss(sums, shuffled));
+}
+
+inline void AccumulateSse(const SwarmView& v, float px, float py, uint32_t begin, uint32_t end, Neighbourhood& n)
+{
+  const __m128 sign = _mm_set1_ps(-0.0f);
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 width = _mm_set1_ps(v.width);
+  const __m128 height = _mm_set1_ps(v.height);
+  const __m128 radius2 = _mm_set1_ps(v.radius2);
+  const __m128 minDistance2 = _mm_set1_ps(v.minDistance2);
+  const __m128 xi = _mm_set1_ps(px);
+  const __m128 yi = _mm_set1_ps(py);
+
+  __m128 ax = _mm_setzero_ps(), ay = _mm_setzero_ps();
+  __m128 sx = _mm_setzero_ps(), sy = _mm_setzero_ps();
+  __m128 cx = _mm_setzero_ps(), cy = _mm_setzero_ps();
+  __m128 counted = _mm_setzero_ps();
+
+  uint32_t j = begin;
+  for (; j + 4 <= end; j += 4)
+  {
+    const __m128 xj = _mm_loadu_ps(v.x + j);
+    const __m128 yj = _mm_loadu_ps(v.y + j);
+
+    const __m128 rx = _mm_sub_ps(xi, xj);
+    const __m128 ry = _mm_sub_ps(yi, yj);
+
+    __m128 dx = _mm_andnot_ps(sign, rx);
+    __m128 dy = _mm_andnot_ps(sign, ry);
+    dx = _mm_min_ps(dx, _mm_sub_ps(width, dx));
+    dy = _mm_min_ps(dy, _mm_sub_ps(height, dy));
+
+    const __m128 d2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+    const __m128 mask = _mm_and_ps(_mm_cmplt_ps(d2, radius2), _mm_cmpge_ps(d2, minDistance2));
+    const __m128 inverse = _mm_and_ps(mask, _mm_div_ps(one, d2));
+
+    ax = _mm_add_ps(ax, _mm_and_ps(mask, _mm_loadu_ps(v.vx + j)));
+    ay = _mm_add_ps(ay, _mm_and_ps(mask, _mm_loadu_ps(v.vy + j)));
+    sx = _mm_add_ps(sx, _mm_mul_ps(rx, inverse));
+    sy = _mm_add_ps(sy, _mm_mul_ps(ry, inverse));
+    cx = _mm_add_ps(cx, _mm_and_ps(mask, xj));
+    cy = _mm_add_ps(cy, _mm_and_ps(mask, yj));
+    counted = _mm_add_ps(counted, _mm_and_ps(mask, one));
+  }
+
+  n.alignmentX += HorizontalSum(ax);
+  n.alignmentY += HorizontalSum(ay);
+  n.separationX += HorizontalSum(sx);
+  n.separationY += HorizontalSum(sy);
+  n.cohesionX += HorizontalSum(cx);
+  n.cohesionY += HorizontalSum(cy);
+  n.counted += HorizontalSum(counted);
+
+  AccumulateScalar(v, px, py, j, end, n);
+}
+
+__attribute__((target("avx2")))
+inline float HorizontalSum(__m256 v)
+{
+  return HorizontalSum(_mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1)));
+}
+
+__attribute__((target("avx2")))
+inline void AccumulateAvx2(const SwarmView& v, float px, float py, uint32_t begin, uint32_t end, Neighbourhood& n)
+{
+  const __m256 sign = _mm256_set1_ps(-0.0f);
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 width = _mm256_set1_ps(v.width);
+  const __m256 height = _mm256_set1_ps(v.height);
+  const __m256 radius2 = _mm256_set1_ps(v.radius2);
+  const __m256 minDistance2 = _mm256_set1_ps(v.minDistance2);
+  const __m256 xi = _mm256_set1_ps(px);
+  const __m256 yi = _mm256_set1_ps(py);
+
+  __m256 ax = _mm256_setzero_ps(), ay = _mm256_setzero_ps();
+  __m256 sx = _mm256_setzero_ps(), sy = _mm256_setzero_ps();
+  __m256 cx = _mm256_setzero_ps(), cy = _mm256_setzero_ps();
+  __m256 counted = _mm256_setzero_ps();
+
+  uint32_t j = begin;
+  for (; j + 8 <= end; j += 8)
+  {
+    const __m256 xj = _mm256_loadu_ps(v.x + j);
+    const __m256 yj = _mm256_loadu_ps(v.y + j);
+
+    const __m256 rx = _mm256_sub_ps(xi, xj);
+    const __m256 ry = _mm256_sub_ps(yi, yj);
+
+    __m256 dx = _mm256_andnot_ps(sign, rx);
+    __m256 dy = _mm256_andnot_ps(sign, ry);
+    dx = _mm256_min_ps(dx, _mm256_sub_ps(width, dx));
+    dy = _mm256_min_ps(dy, _mm256_sub_ps(height, dy));
+
+    const __m256 d2 = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+    const __m256 mask = _mm256_and_ps(_mm256_cmp_ps(d2, radius2, _CMP_LT_OQ),
+                                      _mm256_cmp_ps(d2, minDistance2, _CMP_GE_OQ));
+    const __m256 inverse = _mm256_and_ps(mask, _mm256_div_ps(one, d2));
+
+    ax = _mm256_add_ps(ax, _mm256_and_ps(mask, _mm256_loadu_ps(v.vx + j)));
+    ay = _mm256_add_ps(ay, _mm256_and_ps(mask, _mm256_loadu_ps(v.vy + j)));
+    sx = _mm256_add_ps(sx, _mm256_mul_ps(rx, inverse));
+    sy = _mm256_add_ps(sy, _mm256_mul_ps(ry, inverse));
+    cx = _mm256_add_ps(cx, _mm256_and_ps(mask, xj));
+    cy = _mm256_add_ps(cy, _mm256_and_ps(mask, yj));
+    counted = _mm256_add_ps(counted, _mm256_and_ps(mask, one));
+  }
+
+  n.alignmentX += HorizontalSum(ax);
+  n.alignmentY += HorizontalSum(ay);
+  n.separationX += HorizontalSum(sx);
+  n.separationY += HorizontalSum(sy);
+  n.cohesionX += HorizontalSum(cx);
+  n.cohesionY += HorizontalSum(cy);
+  n.counted += HorizontalSum(counted);
+
+  AccumulateSse(v, px, py, j, end, n);
+}
+#elif defined(__wasm_simd128__)
+inline float HorizontalSum(v128_t v)
+{
+  return wasm_f32x4_extract_lane(v, 0) + wasm_f32x4_extract_lane(v, 1) + wasm_f32x4_extract_lane(v, 2) +
+         wasm_f32x4_extract_lane(v, 3);
+}
+
+inline void AccumulateWasm(const SwarmView& v, float px, float py, uint32_t begin, uint32_t end, Neighbourhood& n)
+{
+  const v128_t one = wasm_f32x4_splat(1.0f);
+  const v128_t width = wasm_f32x4_splat(v.width);
+  const v128_t height = wasm_f32x4_splat(v.height);
+  const v128_t radius2 = wasm_f32x4_splat(v.radius2);
+  const v128_t minDistance2 = wasm_f32x4_splat(v.minDistance2);
+  const v128_t xi = wasm_f32x4_splat(px);
+  const v128_t yi = wasm_f32x4_splat(py);
+
+  v128_t ax = wasm_f32x4_splat(0), ay = wasm_f32x4_splat(0);
+  v128_t sx = wasm_f32x4_splat(0), sy = wasm_f32x4_splat(0);
+  v128_t cx = wasm_f32x4_splat(0), cy = wasm_f32x4_splat(0);
+  v128_t counted = wasm_f32x4_splat(0);
+
+  uint32_t j = begin;
+  for (; j + 4 <= end; j += 4)
+  {
+    const v128_t xj = wasm_v128_load(v.x + j);
+    const v128_t yj = wasm_v128_load(v.y + j);
+
+    const v128_t rx = wasm_f32x4_sub(xi, xj);
+    const v128_t ry = wasm_f32x4_sub(yi, yj);
+
+    v128_t dx = wasm_f32x4_abs(rx);
+    v128_t dy = wasm_f32x4_abs(ry);
+    dx = wasm_f32x4_pmin(dx, wasm_f32x4_sub(width, dx));
+    dy = wasm_f32x4_pmin(dy, wasm_f32x4_sub(height, dy));
+
+    const v128_t d2 = wasm_f32x4_add(wasm_f32x4_mul(dx, dx), wasm_f32x4_mul(dy, dy));
+    const v128_t mask = wasm_v128_and(wasm_f32x4_lt(d2, radius2), wasm_f32x4_ge(d2, minDistance2));
+    const v128_t inverse = wasm_v128_and(mask, wasm_f32x4_div(one, d2));
+
+    ax = wasm_f32x4_add(ax, wasm_v128_and(mask, wasm_v128_load(v.vx + j)));
+    ay = wasm_f32x4_add(ay, wasm_v128_and(mask, wasm_v128_load(v.vy + j)));
+    sx = wasm_f32x4_add(sx, wasm_f32x4_mul(rx, inverse));
+    sy = wasm_f32x4_add(sy, wasm_f32x4_mul(ry, inverse));
+    cx = wasm_f32x4_add(cx, wasm_v128_and(mask, xj));
+    cy = wasm_f32x4_add(cy, wasm_v128_and(mask, yj));
+    counted = wasm_f32x4_add(counted, wasm_v128_and(mask, one));
+  }
+
+  n.alignmentX += HorizontalSum(ax);
+  n.alignmentY += HorizontalSum(ay);
+  n.separationX += HorizontalSum(sx);
+  n.separationY += HorizontalSum(sy);
+  n.cohesionX += HorizontalSum(cx);
+  n.cohesionY += HorizontalSum(cy);
+  n.counted += HorizontalSum(counted);
+
+  AccumulateScalar(v, px, py, j, end, n);
+}
+#endif
+
+inline SwarmKernel SelectKernel(const char** name = nullptr)
+{
+  static const cpu::Option<SwarmKernel> kernels[] = {
+#if defined(__x86_64__)
+    {cpu::AVX2, "avx2", AccumulateAvx2},
+    {cpu::BASELINE, "sse", AccumulateSse},
+#elif defined(__wasm_simd128__)
+    {cpu::BASELINE, "simd128", AccumulateWasm},
+#else
+    {cpu::BASELINE, "scalar", AccumulateScalar},
+#endif
+  };
+
+  return cpu::Select(kernels, name);
+}
+
+// Flock stored as a structure of arrays. Every step the boids are reordered by
+// grid cell, so the neighbours of a boid are a few contiguous runs that the
+// kernels can stream through. The sorted copy doubles as the snapshot of the
+// previous step, which lets the boids be updated in parallel.
+class BoidSwarm
+{
+public:
+  BoidSwarm(float width, float height, const SteeringParameters& parameters = SteeringParameters(), unsigned threads = 0)
+    : mWidth(width)
+    , mHeight(height)
+    , mParameters(parameters)
+    , mGrid(width, height, parameters.radius)
+    , mKernel(SelectKernel(&mKernelName))
+    , mPool(threads)
+  {
+  }
+
+  // Random position and heading, drawn the same way as Boid
+  void AddBoid()
+  {
+    mX.push_back(rand() % int(mWidth));
+    mY.push_back(rand() % int(mHeight));
+
+    double angle = double(rand() % 314) / 100;
+    linalg::Double2d velocity(rand() % int(mParameters.maxSpeed) + 1, angle, linalg::Format::Polar);
+    mVx.push_back(velocity.X());
+    mVy.push_back(velocity.Y());
+  }
+
+  size_t Size() const
+  {
+    return mX.size();
+  }
+
+  float X(size_t i) const { return mX[i]; }
+  float Y(size_t i) const { return mY[i]; }
+  float Vx(size_t i) const { return mVx[i]; }
+  float Vy(size_t i) const { return mVy[i]; }
+
+  const char* KernelName() const
+  {
+    return mKernelName;
+  }
+
+  unsigned Threads() const
+  {
+    return mPool.Size();
+  }
+
+  void Update(double a, double s, double c)
+  {
+    mParameters.alignment = a;
+    mParameters.separation = s;
+    mParameters.cohesion = c;
+
+    Sort();
+
+    const SwarmView view{mSortedX.data(), mSortedY.data(), mSortedVx.data(), mSortedVy.data(),
+                         mWidth, mHeight,
+                         mParameters.radius * mParameters.radius,
+                         mParameters.minDistance * mParameters.minDistance};
+
+    mPool.ParallelFor(0, Size(), SWARM_GRAIN, [&](size_t begin, size_t end)
+    {
+      for (size_t i = begin; i < end; ++i)
+        Step(view, i);
+    });
+  }
+
+private:
+  // Copy the current state into cell order, the sorted copy is read-only during a step
+  void Sort()
+  {
+    mGrid.Build(Size(), [this](size_t i) { return linalg::Double2d(mX[i], mY[i]); });
+
+    mSortedX.resize(Size());
+    mSortedY.resize(Size());
+    mSortedVx.resize(Size());
+    mSortedVy.resize(Size());
+
+    const auto& order = mGrid.Order();
+    for (size_t k = 0; k < order.size(); ++k)
+    {
+      mSortedX[k] = mX[order[k]];
+      mSortedY[k] = mY[order[k]];
+      mSortedVx[k] = mVx[order[k]];
+      mSortedVy[k] = mVy[order[k]];
+    }
+  }
+
+  void Step(const SwarmView& view, uint32_t i)
+  {
+    const float px = view.x[i];
+    const float py = view.y[i];
+    const float vx = view.vx[i];
+    const float vy = view.vy[i];
+
+    Neighbourhood n;
+    mGrid.ForEachNeighbourSpan(linalg::Double2d(px, py), [&](uint32_t begin, uint32_t end)
+    {
+      if (i >= begin && i < end)
+      {
+        mKernel(view, px, py, begin, i, n);
+        mKernel(view, px, py, i + 1, end, n);
+      }
+      else
+      {
+        mKernel(view, px, py, begin, end, n);
+      }
+    });
+
+    float accX = 0, accY = 0;
+    if (n.counted > 0)
+    {
+      const float inverse = 1.0f / n.counted;
+
+      float x = n.alignmentX * inverse, y = n.alignmentY * inverse;
+      Steer(x, y, vx, vy);
+      accX += x * mParameters.alignment;
+      accY += y * mParameters.alignment;
+
+      x = n.separationX * inverse, y = n.separationY * inverse;
+      Steer(x, y, vx, vy);
+      accX += x * mParameters.separation;
+      accY += y * mParameters.separation;
+
+      x = n.cohesionX * inverse - px, y = n.cohesionY * inverse - py;
+      Steer(x, y, vx, vy);
+      accX += x * mParameters.cohesion;
+      accY += y * mParameters.cohesion;
+    }
+
+    // Results go back to the unsorted arrays, the view is never written to
+    const uint32_t id = mGrid.Order()[i];
+
+    float nx = px + vx, ny = py + vy;
+    float nvx = vx + accX, nvy = vy + accY;
+    Limit(nvx, nvy, mParameters.maxSpeed);
+
+    if (nx < 0)
+      nx = mWidth;
+    else if (nx > mWidth)
+      nx = 0;
+
+    if (ny < 0)
+      ny = mHeight;
+    else if (ny > mHeight)
+      ny = 0;
+
+    mX[id] = nx;
+    mY[id] = ny;
+    mVx[id] = nvx;
+    mVy[id] = nvy;
+  }
+
+  // Desired direction at full speed, minus the current velocity, limited to the max force
+  void Steer(float& x, float& y, float vx, float vy) const
+  {
+    const float magnitude = std::sqrt(x * x + y * y);
+    if (magnitude > 0)
+    {
+      x *= mParameters.maxSpeed / magnitude;
+      y *= mParameters.maxSpeed / magnitude;
+    }
+
+    x -= vx;
+    y -= vy;
+    Limit(x, y, mParameters.maxForce);
+  }
+
+  static void Limit(float& x, float& y, float limit)
+  {
+    const float magnitude = std::sqrt(x * x + y * y);
+    if (magnitude <= limit)
+      return;
+
+    x *= limit / magnitude;
+    y *= limit / magnitude;
+  }
+
+  const float mWidth;
+  const float mHeight;
+
+  SteeringParameters mParameters;
+  SpatialGrid mGrid;
+
+  const char* mKernelName;
+  const SwarmKernel mKernel;
+  ThreadPool mPool;
+
+  std::vector<float> mX, mY, mVx, mVy;
+  std::vector<float> mSortedX, mSortedY, mSortedVx, mSortedVy;
+};
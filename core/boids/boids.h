@@ -0,0 +1,313 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include "linalg.h"
+#include "spatial_grid.h"
+#include "thread_pool.h"
+
+#define BOIDS_WIDTH 640
+#define BOIDS_HEIGHT 480
+#define BOIDS_COUNT 100
+#define BOIDS_RADIUS 100
+#define BOIDS_MAX_SPEED 3
+#define BOIDS_GRAIN 256
+
+inline double ToroidalDistance(linalg::Double2d p1, linalg::Double2d p2, int width, int height)
+{
+  float dx = std::abs(p2.X() - p1.X());
+  float dy = std::abs(p2.Y() - p1.Y());
+
+  if (dx > width / 2)
+      dx = width - dx;
+
+  if (dy > height / 2)
+      dy = height - dy;
+
+  return std::sqrt(dx * dx + dy * dy);
+}
+
+class Boid
+{
+public:
+  // Start with a random position in the world
+  Boid(uint32_t id, int width = BOIDS_WIDTH, int height = BOIDS_HEIGHT)
+    : mId(id)
+    , mWidth(width)
+    , mHeight(height)
+  {
+    mPos = linalg::Double2d(rand() % mWidth, rand() % mHeight);
+
+    double angle = double(rand() % 314) / 100;
+    mVel = linalg::Double2d(rand() % (int)mMaxSpeed + 1, angle, linalg::Format::Polar);
+  }
+
+  uint32_t Id() const
+  {
+    return mId;
+  }
+
+  linalg::Double2d Position() const
+  {
+    return mPos;
+  }
+
+  linalg::Double2d Velocity() const
+  {
+    return mVel;
+  }
+
+  void UpdateMultipliers(double a, double s, double c)
+  {
+    aMultiplier = a;
+    sMultiplier = s;
+    cMultiplier = c;
+  }
+
+  linalg::Double2d Alignment(const std::vector<Boid>& boids, const SpatialGrid& grid) const
+  {
+    int counted = 0;
+    linalg::Double2d avg;
+
+    grid.ForEachNeighbour(mPos, [&](uint32_t index)
+    {
+      const Boid& b = boids[index];
+      if (b.Id() == Id())
+        return;
+
+      if (mPos.Distance(b.Position()) >= mRadius)
+        return;
+
+      avg += b.Velocity();
+      ++counted;
+    });
+
+    if (counted > 0)
+    {
+      avg /= counted;
+      avg.SetMagnitude(mMaxSpeed);
+      avg -= Velocity();
+      avg.Limit(mMaxForce);
+    }
+
+    return avg;
+  }
+
+  linalg::Double2d Separation(const std::vector<Boid>& boids, const SpatialGrid& grid) const
+  {
+    int counted = 0;
+    double radius = 70;
+    linalg::Double2d avg;
+
+    grid.ForEachNeighbour(mPos, [&](uint32_t index)
+    {
+      const Boid& b = boids[index];
+      if (b.Id() == Id())
+        return;
+
+      auto distance = mPos.Distance(b.Position());
+      if (distance >= radius || distance < 0.01)
+        return;
+
+      auto diff = Position() - b.Position();
+      diff /= distance * distance;
+
+      avg += diff;
+      ++counted;
+    });
+
+    if (counted > 0)
+    {
+      avg /= counted;
+      avg.SetMagnitude(mMaxSpeed);
+      avg -= Velocity();
+      avg.Limit(mMaxForce);
+    }
+
+    return avg;
+  }
+
+  linalg::Double2d Cohesion(const std::vector<Boid>& boids, const SpatialGrid& grid) const
+  {
+    int counted = 0;
+    double radius = 100;
+    linalg::Double2d avg;
+
+    grid.ForEachNeighbour(mPos, [&](uint32_t index)
+    {
+      const Boid& b = boids[index];
+      if (b.Id() == Id())
+        return;
+
+      if (mPos.Distance(b.Position()) >= radius)
+        return;
+
+      avg += b.Position();
+      ++counted;
+    });
+
+    if (counted > 0)
+    {
+      avg /= counted;
+      avg -= Position();
+      avg.SetMagnitude(mMaxSpeed);
+      avg -= Velocity();
+      avg.Limit(mMaxForce);
+    }
+
+    return avg;
+  }
+
+  linalg::Double2d Combined(const std::vector<Boid>& boids, const SpatialGrid& grid) const
+  {
+    int counted = 0;
+    linalg::Double2d avgAlignment, avgSeparation, avgCohesion;
+
+    grid.ForEachNeighbour(mPos, [&](uint32_t index)
+    {
+      const Boid& b = boids[index];
+      if (b.Id() == Id())
+        return;
+
+      auto distance = ToroidalDistance(mPos, b.Position(), mWidth, mHeight);  // mPos.Distance(b.Position());
+      if (distance >= mRadius || distance < 0.01)
+        return;
+
+      // Alignment
+      avgAlignment += b.Velocity();
+
+      // Separation
+      auto diff = Position() - b.Position();
+      diff /= distance * distance;
+      avgSeparation += diff;
+
+      // Cohesion
+      avgCohesion += b.Position();
+
+      ++counted;
+    });
+
+    if (counted > 0)
+    {
+      // Alignment
+      avgAlignment /= counted;
+      avgAlignment.SetMagnitude(mMaxSpeed);
+      avgAlignment -= Velocity();
+      avgAlignment.Limit(mMaxForce);
+
+      // Separation
+      avgSeparation /= counted;
+      avgSeparation.SetMagnitude(mMaxSpeed);
+      avgSeparation -= Velocity();
+      avgSeparation.Limit(mMaxForce);
+
+      avgCohesion /= counted;
+      avgCohesion -= Position();
+      avgCohesion.SetMagnitude(mMaxSpeed);
+      avgCohesion -= Velocity();
+      avgCohesion.Limit(mMaxForce);
+    }
+
+    return (avgAlignment * aMultiplier) + (avgSeparation * sMultiplier) + (avgCohesion * cMultiplier);
+  }
+
+  void Boundaries(linalg::Double2d& p)
+  {
+    if (p.X() < 0)
+      p[0] = mWidth;
+    else if (p.X() > mWidth)
+      p[0] = 0;
+
+    if (p.Y() < 0)
+      p[1] = mHeight;
+    else if (p.Y() > mHeight)
+      p[1] = 0;
+  }
+
+  void Update(const std::vector<Boid>& boids, const SpatialGrid& grid)
+  {
+    linalg::Double2d acceleration = Combined(boids, grid);
+
+    linalg::Double2d p = mPos + mVel;
+
+    mVel += acceleration;
+    mVel.Limit(mMaxSpeed);
+
+    Boundaries(p);
+
+    mPos = p;
+  }
+
+private:
+  uint32_t mId;
+  int mWidth;
+  int mHeight;
+  uint32_t mRadius = BOIDS_RADIUS;
+
+  double mMaxSpeed = BOIDS_MAX_SPEED;
+  double mMaxForce = 0.2;
+
+  double aMultiplier, sMultiplier, cMultiplier;
+
+  linalg::Double2d mPos, mVel;
+};
+
+class Boids
+{
+public:
+  Boids(int width = BOIDS_WIDTH, int height = BOIDS_HEIGHT, unsigned threads = 0)
+    : mWidth(width)
+    , mHeight(height)
+    , mGrid(width, height, BOIDS_RADIUS)
+    , mPool(threads)
+  {}
+
+  void AddBoid()
+  {
+    mBoids.push_back(Boid(mBoids.size(), mWidth, mHeight));
+  }
+
+  size_t Size() const
+  {
+    return mBoids.size();
+  }
+
+  unsigned Threads() const
+  {
+    return mPool.Size();
+  }
+
+  // Every boid reads the state of the previous step, so the result does not
+  // depend on the update order or on the number of threads
+  void Update(double a, double s, double c)
+  {
+    mPrevious = mBoids;
+    mGrid.Build(mPrevious);
+
+    mPool.ParallelFor(0, mBoids.size(), BOIDS_GRAIN, [&](size_t begin, size_t end)
+    {
+      for (size_t i = begin; i < end; ++i)
+      {
+        mBoids[i].UpdateMultipliers(a, s, c);
+        mBoids[i].Update(mPrevious, mGrid);
+      }
+    });
+  }
+
+  const std::vector<Boid>& All() const
+  {
+    return mBoids;
+  }
+
+private:
+  const int mWidth;
+  const int mHeight;
+
+  std::vector<Boid> mBoids;
+  std::vector<Boid> mPrevious;
+  SpatialGrid mGrid;
+  ThreadPool mPool;
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "boids.h"
+
+// Throughput of an uncapped run, latencies are in milliseconds
+struct Report
+{
+  uint32_t boids = 0;
+  uint32_t steps = 0;
+  double seconds = 0;
+
+  double stepsPerSecond = 0;
+  double updatesPerSecond = 0;
+
+  double p50 = 0;
+  double p90 = 0;
+  double p99 = 0;
+  double max = 0;
+};
+
+// World that holds `count` boids at the same density as the windowed demo
+inline void WorldFor(uint32_t count, int& width, int& height)
+{
+  const double scale = std::sqrt(std::max(1.0, double(count) / BOIDS_COUNT));
+  width = int(BOIDS_WIDTH * scale);
+  height = int(BOIDS_HEIGHT * scale);
+}
+
+// Run `steps` updates of any flock with Size() and Update(a, s, c) and time each one
+template <typename T>
+Report Measure(T& flock, uint32_t steps, double a = 2, double s = 2, double c = 2)
+{
+  using Clock = std::chrono::steady_clock;
+
+  std::vector<double> latencies;
+  latencies.reserve(steps);
+
+  const auto start = Clock::now();
+  for (uint32_t i = 0; i < steps; ++i)
+  {
+    const auto before = Clock::now();
+    flock.Update(a, s, c);
+    latencies.push_back(std::chrono::duration<double, std::milli>(Clock::now() - before).count());
+  }
+
+  Report report;
+  report.boids = flock.Size();
+  report.steps = steps;
+  report.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+  if (steps == 0 || report.seconds <= 0)
+    return report;
+
+  report.stepsPerSecond = steps / report.seconds;
+  report.updatesPerSecond = report.stepsPerSecond * report.boids;
+
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&latencies](double p) { return latencies[size_t(p * (latencies.size() - 1))]; };
+  report.p50 = percentile(0.50);
+  report.p90 = percentile(0.90);
+  report.p99 = percentile(0.99);
+  report.max = latencies.back();
+
+  return report;
+}
+
+inline void Print(const Report& report)
+{
+  printf("boids %u, steps %u in %.3f s\n", report.boids, report.steps, report.seconds);
+  printf("  %.1f steps/s, %.3e boid updates/s\n", report.stepsPerSecond, report.updatesPerSecond);
+  printf("  step latency ms: p50 %.3f, p90 %.3f, p99 %.3f, max %.3f\n", report.p50, report.p90, report.p99, report.max);
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "linalg.h"
+
+// Uniform grid over a toroidal world. Every cell is at least `cellSize` wide,
+// so two points closer than `cellSize` (with wrap-around) always lie in the
+// same or in adjacent cells and a query only has to visit a 3x3 block.
+class SpatialGrid
+{
+public:
+  SpatialGrid(double width, double height, double cellSize)
+    : mColumns(std::max(1, int(width / cellSize)))
+    , mRows(std::max(1, int(height / cellSize)))
+    , mCellWidth(width / mColumns)
+    , mCellHeight(height / mRows)
+  {
+  }
+
+  uint32_t Cell(double x, double y) const
+  {
+    return Row(y) * mColumns + Column(x);
+  }
+
+  // Bucket all items by cell with a counting sort, keeping ids in order inside a cell
+  template <typename T>
+  void Build(const std::vector<T>& items)
+  {
+    Build(items.size(), [&items](size_t i) { return items[i].Position(); });
+  }
+
+  // Same as above for storage that is not a vector of boids, position(i) returns a point
+  template <typename F>
+  void Build(size_t count, F position)
+  {
+    mCells.resize(count);
+    mStart.assign(mColumns * mRows + 1, 0);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+      const auto p = position(i);
+      mCells[i] = Cell(p.X(), p.Y());
+      ++mStart[mCells[i] + 1];
+    }
+
+    for (size_t c = 1; c < mStart.size(); ++c)
+      mStart[c] += mStart[c - 1];
+
+    mIndices.resize(count);
+    mFill.assign(mStart.begin(), mStart.end() - 1);
+    for (size_t i = 0; i < count; ++i)
+      mIndices[mFill[mCells[i]]++] = i;
+  }
+
+  // Item ids sorted by cell, Order()[k] is the item stored at sorted position k
+  const std::vector<uint32_t>& Order() const
+  {
+    return mIndices;
+  }
+
+  // Call f(begin, end) for every run of sorted positions in the 3x3 block of
+  // cells around p. Adjacent cells of a row are merged into a single run.
+  template <typename F>
+  void ForEachNeighbourSpan(const linalg::Double2d& p, F f) const
+  {
+    int columns[3], rows[3];
+    const int nColumns = Around(Column(p.X()), mColumns, columns);
+    const int nRows = Around(Row(p.Y()), mRows, rows);
+
+    for (int r = 0; r < nRows; ++r)
+    {
+      const uint32_t first = rows[r] * mColumns;
+      for (int c = 0; c < nColumns;)
+      {
+        int last = c;
+        while (last + 1 < nColumns && columns[last + 1] == columns[last] + 1)
+          ++last;
+
+        f(mStart[first + columns[c]], mStart[first + columns[last] + 1]);
+        c = last + 1;
+      }
+    }
+  }
+
+  // Call f(index) for every item in the 3x3 block of cells around p
+  template <typename F>
+  void ForEachNeighbour(const linalg::Double2d& p, F f) const
+  {
+    ForEachNeighbourSpan(p, [&](uint32_t begin, uint32_t end)
+    {
+      for (uint32_t i = begin; i < end; ++i)
+        f(mIndices[i]);
+    });
+  }
+
+private:
+  int Column(double x) const
+  {
+    return std::min(mColumns - 1, std::max(0, int(x / mCellWidth)));
+  }
+
+  int Row(double y) const
+  {
+    return std::min(mRows - 1, std::max(0, int(y / mCellHeight)));
+  }
+
+  // Wrapped neighbours of a cell coordinate in ascending order, without
+  // duplicates on tiny grids
+  static int Around(int c, int size, int* out)
+  {
+    if (size < 3)
+    {
+      for (int i = 0; i < size; ++i)
+        out[i] = i;
+      return size;
+    }
+
+    if (c == 0)
+    {
+      out[0] = 0;
+      out[1] = 1;
+      out[2] = size - 1;
+    }
+    else if (c == size - 1)
+    {
+      out[0] = 0;
+      out[1] = size - 2;
+      out[2] = size - 1;
+    }
+    else
+    {
+      out[0] = c - 1;
+      out[1] = c;
+      out[2] = c + 1;
+    }
+
+    return 3;
+  }
+
+  const int mColumns;
+  const int mRows;
+  const double mCellWidth;
+  const double mCellHeight;
+
+  std::vector<uint32_t> mCells;
+  std::vector<uint32_t> mStart;
+  std::vector<uint32_t> mFill;
+  std::vector<uint32_t> mIndices;
+};
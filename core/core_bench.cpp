@@ -0,0 +1,48 @@
+#include "boid_swarm.h"
+#include "engines.h"
+#include "headless.h"
+#include "throughput.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+#define SEED 42
+#define STEPS 50
+#define LIFE_SIZE 1024
+
+// Headless throughput of the swarm and of every Life engine on a random board,
+// the same numbers natively and under node for the wasm builds
+int main(int argc, char* argv[])
+{
+  const unsigned threads = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1;
+
+  printf("%8s %8s %8s %12s %14s %10s %10s\n", "kernel", "threads", "boids", "steps/s", "updates/s", "p50 ms", "p99 ms");
+  for (uint32_t count : {1000u, 10000u, 50000u})
+  {
+    int width, height;
+    WorldFor(count, width, height);
+
+    srand(SEED);
+    BoidSwarm swarm(width, height, SteeringParameters(), threads);
+    for (uint32_t i = 0; i < count; ++i)
+      swarm.AddBoid();
+
+    const Report report = Measure(swarm, STEPS);
+    printf("%8s %8u %8u %12.1f %14.3e %10.3f %10.3f\n", swarm.KernelName(), threads, count, report.stepsPerSecond,
+           report.updatesPerSecond, report.p50, report.p99);
+  }
+
+  printf("\n%-12s %6s %8s %14s %14s\n", "engine", "size", "gens", "ns/gen", "cells/s");
+  for (const char* name : ENGINE_NAMES)
+  {
+    auto engine = MakeEngine(name, LIFE_SIZE, LIFE_SIZE, threads);
+    srand(SEED);
+    engine->Start({});
+
+    const LifeReport report = MeasureLife(*engine);
+    printf("%-12s %6u %8lu %14.1f %14.3e\n", name, engine->Width(), (unsigned long)report.generations,
+           report.nsPerGeneration, report.cellsPerSecond);
+  }
+
+  return 0;
+}
@@ -0,0 +1,372 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include "engine.h"
+#include "thread_pool.h"
+
+#define TILE_ROWS 64
+
+// Bit packed board, 64 cells per word with bit i of word k holding column
+// 64 * k + i. The neighbour counts of a whole word are computed at once with
+// bitwise adders. Two buffers with an always dead row above and below the
+// board are swapped every generation, so there is no copy and no bounds check.
+//
+// The board is also split in tiles of one word by TILE_ROWS rows that remember
+// whether they changed in the last generation. A tile whose own and neighbouring
+// tiles did not change cannot change either and is skipped: both buffers
+// already hold the same words for it.
+//
+// With more than one thread the tile rows are cut in one band per worker. Every
+// band reads the rows just outside its edges from the shared previous generation
+// and only writes its own rows of the next one, so bands never synchronise
+// within a generation and the result is the same as the serial update.
+class BitMap : public Engine
+{
+public:
+  // Rules with a dedicated Step()
+  enum { ANY_RULE, CONWAY, HIGHLIFE };
+
+  BitMap(uint32_t width, uint32_t height, unsigned threads = 1)
+    : mWidth(width)
+    , mHeight(height)
+    , mStride((width + 63) / 64)
+    , mLastMask(width % 64 ? (uint64_t(1) << (width % 64)) - 1 : ~uint64_t(0))
+    , mTileRows((height + TILE_ROWS - 1) / TILE_ROWS)
+    , mCells((height + 2) * mStride, 0)
+    , mNext((height + 2) * mStride, 0)
+    , mChanged(mTileRows * mStride, 1)
+    , mNextChanged(mTileRows * mStride, 1)
+    , mPool(threads)
+    , mBandTiles(std::max(1u, (mTileRows + mPool.Size() - 1) / mPool.Size()))
+    , mBands((mTileRows + mBandTiles - 1) / mBandTiles)
+  {
+    for (auto& band : mBands)
+      band.rowChanged.assign(mStride, 0);
+
+    SetRule(mRule);
+  }
+
+  const char* Name() const override
+  {
+    return "bitmap";
+  }
+
+  uint32_t Width() const override
+  {
+    return mWidth;
+  }
+
+  uint32_t Height() const override
+  {
+    return mHeight;
+  }
+
+  void Start(const std::vector<linalg::Int2d>& initial) override
+  {
+    std::fill(mCells.begin(), mCells.end(), 0);
+    std::fill(mChanged.begin(), mChanged.end(), 1);
+
+    if (initial.empty())
+    {
+      for (uint32_t y = 0; y < mHeight; ++y)
+        for (uint32_t x = 0; x < mWidth; ++x)
+          Set(x, y, (rand() % 100) > ALIVE_PROB);
+
+      return;
+    }
+
+    for (const auto& p : initial)
+    {
+      if (p.X() >= 0 && p.Y() >= 0 && uint32_t(p.X()) < mWidth && uint32_t(p.Y()) < mHeight)
+        Set(p.X(), p.Y(), true);
+    }
+  }
+
+  void Update() override
+  {
+    mPool.ParallelFor(0, mTileRows, mBandTiles, [this](size_t begin, size_t end)
+    {
+      if (mRule.IsConway())
+        UpdateBand<CONWAY>(begin, end, mBands[begin / mBandTiles]);
+      else if (mRule == Rule(HIGHLIFE_BIRTH, HIGHLIFE_SURVIVAL))
+        UpdateBand<HIGHLIFE>(begin, end, mBands[begin / mBandTiles]);
+      else
+        UpdateBand<ANY_RULE>(begin, end, mBands[begin / mBandTiles]);
+    });
+
+    mActiveTiles = 0;
+    for (const auto& band : mBands)
+      mActiveTiles += band.activeTiles;
+
+    mCells.swap(mNext);
+    mChanged.swap(mNextChanged);
+  }
+
+  void SetRule(const Rule& rule) override
+  {
+    mRule = rule;
+
+    // Only counts that keep or make a cell alive, each mask is all ones or all zeros
+    mCounts = 0;
+    for (uint32_t n = 0; n < 9; ++n)
+    {
+      if (!rule.Next(false, n) && !rule.Next(true, n))
+        continue;
+
+      mCount[mCounts] = n;
+      mBirth[mCounts] = rule.Next(false, n) ? ~uint64_t(0) : 0;
+      mSurvival[mCounts] = rule.Next(true, n) ? ~uint64_t(0) : 0;
+      ++mCounts;
+    }
+
+    // Cells that were stable under the old rule may not be under the new one
+    std::fill(mChanged.begin(), mChanged.end(), 1);
+  }
+
+  bool TracksChanges() const override
+  {
+    return true;
+  }
+
+  // One region per run of changed tiles in a tile row
+  void ChangedRegions(std::vector<Region>& regions) const override
+  {
+    for (uint32_t ty = 0; ty < mTileRows; ++ty)
+    {
+      const uint8_t* changed = &mChanged[ty * mStride];
+      for (uint32_t tx = 0; tx < mStride; ++tx)
+      {
+        if (!changed[tx])
+          continue;
+
+        const uint32_t first = tx;
+        while (tx + 1 < mStride && changed[tx + 1])
+          ++tx;
+
+        regions.push_back({first * 64, ty * TILE_ROWS, std::min(mWidth, (tx + 1) * 64), std::min(mHeight, (ty + 1) * TILE_ROWS)});
+      }
+    }
+  }
+
+  // Tiles computed by the last Update(), out of TotalTiles()
+  uint64_t ActiveTiles() const
+  {
+    return mActiveTiles;
+  }
+
+  uint64_t TotalTiles() const
+  {
+    return uint64_t(mTileRows) * mStride;
+  }
+
+  unsigned Threads() const
+  {
+    return mPool.Size();
+  }
+
+  bool Alive(uint32_t x, uint32_t y) const override
+  {
+    return (mCells[(y + 1) * mStride + x / 64] >> (x % 64)) & 1;
+  }
+
+  void Row(uint32_t y, uint32_t x0, uint32_t count, uint64_t* words) const override
+  {
+    CopyBits(&mCells[(y + 1) * mStride], mStride, x0, count, words);
+  }
+
+  void Set(uint32_t x, uint32_t y, bool alive)
+  {
+    uint64_t& word = mCells[(y + 1) * mStride + x / 64];
+    const uint64_t bit = uint64_t(1) << (x % 64);
+    word = alive ? (word | bit) : (word & ~bit);
+    mChanged[(y / TILE_ROWS) * mStride + x / 64] = 1;
+  }
+
+  uint64_t Population() const override
+  {
+    uint64_t population = 0;
+    for (uint64_t word : mCells)
+      population += __builtin_popcountll(word);
+
+    return population;
+  }
+
+  uint64_t CountAlive(uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1) const override
+  {
+    uint64_t population = 0;
+    for (uint32_t k = x0 / 64; k * 64 < x1; ++k)
+    {
+      // Columns of word k inside [x0, x1)
+      const uint32_t first = std::max(x0, k * 64) - k * 64;
+      const uint32_t last = std::min(x1, k * 64 + 64) - k * 64;
+      const uint64_t mask = (last == 64 ? ~uint64_t(0) : (uint64_t(1) << last) - 1) & ~((uint64_t(1) << first) - 1);
+
+      for (uint32_t y = y0; y < y1; ++y)
+        population += __builtin_popcountll(mCells[(y + 1) * mStride + k] & mask);
+    }
+
+    return population;
+  }
+
+private:
+  // Scratch space of one band, reused every generation
+  struct Band
+  {
+    std::vector<uint8_t> rowChanged;
+    std::vector<uint32_t> active;
+    uint64_t activeTiles = 0;
+  };
+
+  template <int Kind>
+  void UpdateBand(uint32_t firstTile, uint32_t lastTile, Band& band)
+  {
+    band.activeTiles = 0;
+
+    for (uint32_t ty = firstTile; ty < lastTile; ++ty)
+    {
+      band.active.clear();
+      for (uint32_t tx = 0; tx < mStride; ++tx)
+      {
+        mNextChanged[ty * mStride + tx] = 0;
+        if (NeighbourhoodChanged(tx, ty))
+          band.active.push_back(tx);
+      }
+
+      if (band.active.empty())
+        continue;
+
+      band.activeTiles += band.active.size();
+
+      // Walk the active tiles row by row to stay in cache
+      const uint32_t last = std::min(mHeight, (ty + 1) * TILE_ROWS);
+      for (uint32_t y = ty * TILE_ROWS + 1; y <= last; ++y)
+      {
+        const uint64_t* above = &mCells[(y - 1) * mStride];
+        const uint64_t* row = &mCells[y * mStride];
+        const uint64_t* below = &mCells[(y + 1) * mStride];
+        uint64_t* out = &mNext[y * mStride];
+
+        if (band.active.size() == mStride)
+        {
+          for (uint32_t k = 0; k < mStride; ++k)
+            out[k] = Step<Kind>(above, row, below, k);
+
+          out[mStride - 1] &= mLastMask;
+          for (uint32_t k = 0; k < mStride; ++k)
+            band.rowChanged[k] |= out[k] != row[k];
+
+          continue;
+        }
+
+        for (uint32_t k : band.active)
+        {
+          uint64_t word = Step<Kind>(above, row, below, k);
+          if (k == mStride - 1)
+            word &= mLastMask;
+
+          band.rowChanged[k] |= word != row[k];
+          out[k] = word;
+        }
+      }
+
+      for (uint32_t k : band.active)
+      {
+        mNextChanged[ty * mStride + k] = band.rowChanged[k];
+        band.rowChanged[k] = 0;
+      }
+    }
+  }
+
+  bool NeighbourhoodChanged(uint32_t tx, uint32_t ty) const
+  {
+    for (uint32_t y = ty > 0 ? ty - 1 : 0; y <= ty + 1 && y < mTileRows; ++y)
+      for (uint32_t x = tx > 0 ? tx - 1 : 0; x <= tx + 1 && x < mStride; ++x)
+        if (mChanged[y * mStride + x])
+          return true;
+
+    return false;
+  }
+
+  // Next state of the 64 cells in word k of a row
+  template <int Kind>
+  uint64_t Step(const uint64_t* above, const uint64_t* row, const uint64_t* below, uint32_t k) const
+  {
+    uint64_t aw, ac, ae, mw, mc, me, bw, bc, be;
+    Neighbours(above, k, aw, ac, ae);
+    Neighbours(row, k, mw, mc, me);
+    Neighbours(below, k, bw, bc, be);
+
+    // Rows above and below: three inputs each, middle row: two inputs
+    uint64_t a1 = aw ^ ac ^ ae, a2 = (aw & ac) | (ae & (aw ^ ac));
+    uint64_t b1 = bw ^ bc ^ be, b2 = (bw & bc) | (be & (bw ^ bc));
+    uint64_t m1 = mw ^ me, m2 = mw & me;
+
+    // count = s0 + 2 * (a2 + b2 + m2 + c0)
+    uint64_t s0 = a1 ^ b1 ^ m1, c0 = (a1 & b1) | (m1 & (a1 ^ b1));
+    uint64_t p = a2 ^ b2 ^ m2, q = (a2 & b2) | (m2 & (a2 ^ b2));
+    uint64_t t0 = p ^ c0;
+
+    // count = s0 + 2 * t0 + 4 * u0 + 8 * u1
+    uint64_t u0 = q ^ (p & c0), u1 = q & p & c0;
+
+    if (Kind != ANY_RULE)
+    {
+      // Twos equal to one means a count of 2 or 3, birth needs the ones bit
+      uint64_t conway = t0 & ~(u0 | u1) & (s0 | mc);
+      if (Kind == CONWAY)
+        return conway;
+
+      // HighLife also gives birth at 6
+      return conway | (~mc & ~s0 & t0 & u0);
+    }
+
+    // Pick the counts the rule keeps
+    uint64_t next = 0;
+    for (uint32_t i = 0; i < mCounts; ++i)
+    {
+      const uint32_t n = mCount[i];
+      uint64_t count = (n & 1 ? s0 : ~s0) & (n & 2 ? t0 : ~t0) & (n & 4 ? u0 : ~u0) & (n & 8 ? u1 : ~u1);
+      next |= count & ((mc & mSurvival[i]) | (~mc & mBirth[i]));
+    }
+
+    return next;
+  }
+
+  // The word itself and its cells shifted so that each bit sees its west and east neighbour
+  void Neighbours(const uint64_t* row, uint32_t k, uint64_t& west, uint64_t& centre, uint64_t& east) const
+  {
+    centre = row[k];
+    const uint64_t before = k > 0 ? row[k - 1] : 0;
+    const uint64_t after = k + 1 < mStride ? row[k + 1] : 0;
+
+    west = (centre << 1) | (before >> 63);
+    east = (centre >> 1) | (after << 63);
+  }
+
+  const uint32_t mWidth;
+  const uint32_t mHeight;
+  const uint32_t mStride;
+  const uint64_t mLastMask;
+  const uint32_t mTileRows;
+
+  std::vector<uint64_t> mCells;
+  std::vector<uint64_t> mNext;
+
+  // Per tile flags, row major with mStride tiles per row
+  std::vector<uint8_t> mChanged;
+  std::vector<uint8_t> mNextChanged;
+
+  // Rule as masks for the neighbour counts it uses
+  uint32_t mCounts = 0;
+  uint32_t mCount[9];
+  uint64_t mBirth[9];
+  uint64_t mSurvival[9];
+
+  ThreadPool mPool;
+  const uint32_t mBandTiles;
+  std::vector<Band> mBands;
+  uint64_t mActiveTiles = 0;
+};
@@ -0,0 +1,317 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#endif
+
+#include "cpu_dispatch.h"
+#include "engine.h"
+#include "thread_pool.h"
+
+#define BYTE_MAP_GRAIN 64
+
+// Next state of a dead cell by neighbour count, then of a live one. Sixteen
+// entries each so they can be used directly as byte shuffle tables.
+struct RuleTables
+{
+  alignas(16) uint8_t birth[16];
+  alignas(16) uint8_t survival[16];
+};
+
+// Writes the next state of `count` cells. The pointers are at the first cell of
+// the row above, the row itself and the row below; the cells left and right of
+// the range must be readable.
+using RowKernel = void (*)(const uint8_t*, const uint8_t*, const uint8_t*, uint8_t*, uint32_t, const RuleTables&);
+
+inline void RowScalar(const uint8_t* above, const uint8_t* row, const uint8_t* below, uint8_t* out, uint32_t count, const RuleTables& tables)
+{
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    const uint8_t* a = above + i;
+    const uint8_t* r = row + i;
+    const uint8_t* b = below + i;
+    const uint32_t neighbours = a[-1] + a[0] + a[1] + r[-1] + r[1] + b[-1] + b[0] + b[1];
+
+    out[i] = r[0] ? tables.survival[neighbours] : tables.birth[neighbours];
+  }
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.1")))
+inline __m128i Load128(const uint8_t* p)
+{
+  return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+
+__attribute__((target("sse4.1")))
+inline void RowSse(const uint8_t* above, const uint8_t* row, const uint8_t* below, uint8_t* out, uint32_t count, const RuleTables& tables)
+{
+  const __m128i birth = _mm_load_si128(reinterpret_cast<const __m128i*>(tables.birth));
+  const __m128i survival = _mm_load_si128(reinterpret_cast<const __m128i*>(tables.survival));
+  const __m128i zero = _mm_setzero_si128();
+
+  uint32_t i = 0;
+  for (; i + 16 <= count; i += 16)
+  {
+    const uint8_t* a = above + i;
+    const uint8_t* r = row + i;
+    const uint8_t* b = below + i;
+
+    __m128i sum = _mm_add_epi8(_mm_add_epi8(Load128(a - 1), Load128(a)), Load128(a + 1));
+    sum = _mm_add_epi8(sum, _mm_add_epi8(Load128(r - 1), Load128(r + 1)));
+    sum = _mm_add_epi8(sum, _mm_add_epi8(_mm_add_epi8(Load128(b - 1), Load128(b)), Load128(b + 1)));
+
+    const __m128i alive = _mm_cmpgt_epi8(Load128(r), zero);
+    const __m128i next = _mm_blendv_epi8(_mm_shuffle_epi8(birth, sum), _mm_shuffle_epi8(survival, sum), alive);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), next);
+  }
+
+  RowScalar(above + i, row + i, below + i, out + i, count - i, tables);
+}
+
+__attribute__((target("avx2")))
+inline __m256i Load256(const uint8_t* p)
+{
+  return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+}
+
+__attribute__((target("avx2")))
+inline void RowAvx2(const uint8_t* above, const uint8_t* row, const uint8_t* below, uint8_t* out, uint32_t count, const RuleTables& tables)
+{
+  // The shuffle works per 128 bit lane, so both lanes get the whole table
+  const __m256i birth = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(tables.birth)));
+  const __m256i survival = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(tables.survival)));
+  const __m256i zero = _mm256_setzero_si256();
+
+  uint32_t i = 0;
+  for (; i + 32 <= count; i += 32)
+  {
+    const uint8_t* a = above + i;
+    const uint8_t* r = row + i;
+    const uint8_t* b = below + i;
+
+    __m256i sum = _mm256_add_epi8(_mm256_add_epi8(Load256(a - 1), Load256(a)), Load256(a + 1));
+    sum = _mm256_add_epi8(sum, _mm256_add_epi8(Load256(r - 1), Load256(r + 1)));
+    sum = _mm256_add_epi8(sum, _mm256_add_epi8(_mm256_add_epi8(Load256(b - 1), Load256(b)), Load256(b + 1)));
+
+    const __m256i alive = _mm256_cmpgt_epi8(Load256(r), zero);
+    const __m256i next = _mm256_blendv_epi8(_mm256_shuffle_epi8(birth, sum), _mm256_shuffle_epi8(survival, sum), alive);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), next);
+  }
+
+  RowSse(above + i, row + i, below + i, out + i, count - i, tables);
+}
+#elif defined(__wasm_simd128__)
+inline void RowWasm(const uint8_t* above, const uint8_t* row, const uint8_t* below, uint8_t* out, uint32_t count, const RuleTables& tables)
+{
+  const v128_t birth = wasm_v128_load(tables.birth);
+  const v128_t survival = wasm_v128_load(tables.survival);
+  const v128_t zero = wasm_i8x16_splat(0);
+
+  uint32_t i = 0;
+  for (; i + 16 <= count; i += 16)
+  {
+    const uint8_t* a = above + i;
+    const uint8_t* r = row + i;
+    const uint8_t* b = below + i;
+
+    v128_t sum = wasm_i8x16_add(wasm_i8x16_add(wasm_v128_load(a - 1), wasm_v128_load(a)), wasm_v128_load(a + 1));
+    sum = wasm_i8x16_add(sum, wasm_i8x16_add(wasm_v128_load(r - 1), wasm_v128_load(r + 1)));
+    sum = wasm_i8x16_add(sum, wasm_i8x16_add(wasm_i8x16_add(wasm_v128_load(b - 1), wasm_v128_load(b)), wasm_v128_load(b + 1)));
+
+    const v128_t alive = wasm_i8x16_gt(wasm_v128_load(r), zero);
+    const v128_t next = wasm_v128_bitselect(wasm_i8x16_swizzle(survival, sum), wasm_i8x16_swizzle(birth, sum), alive);
+    wasm_v128_store(out + i, next);
+  }
+
+  RowScalar(above + i, row + i, below + i, out + i, count - i, tables);
+}
+#endif
+
+inline RowKernel SelectRowKernel(const char** name = nullptr)
+{
+  static const cpu::Option<RowKernel> kernels[] = {
+#if defined(__x86_64__)
+    {cpu::AVX2, "avx2", RowAvx2},
+    {cpu::SSE41, "sse4.1", RowSse},
+#elif defined(__wasm_simd128__)
+    {cpu::BASELINE, "simd128", RowWasm},
+#endif
+    {cpu::BASELINE, "scalar", RowScalar},
+  };
+
+  return cpu::Select(kernels, name);
+}
+
+// One byte per cell, 0 or 1, with a dead border around the board. Neighbour
+// counts are plain byte additions of the shifted rows, which the vector kernels
+// do for 16 or 32 cells at once before looking the next state up in the rule.
+// Rows are padded to whole vectors so the kernels never need a scalar tail.
+class ByteMap : public Engine
+{
+public:
+  ByteMap(uint32_t width, uint32_t height, unsigned threads = 1)
+    : mWidth(width)
+    , mHeight(height)
+    , mStride((width + 31) / 32 * 32 + 32)
+    , mCells(size_t(height + 2) * mStride, 0)
+    , mNext(size_t(height + 2) * mStride, 0)
+    , mSpans(height, Span{0, width})
+    , mKernel(SelectRowKernel(&mKernelName))
+    , mPool(threads)
+  {
+    SetRule(mRule);
+  }
+
+  const char* Name() const override
+  {
+    return "bytemap";
+  }
+
+  uint32_t Width() const override
+  {
+    return mWidth;
+  }
+
+  uint32_t Height() const override
+  {
+    return mHeight;
+  }
+
+  void Start(const std::vector<linalg::Int2d>& initial) override
+  {
+    std::fill(mCells.begin(), mCells.end(), 0);
+    std::fill(mSpans.begin(), mSpans.end(), Span{0, mWidth});
+
+    if (initial.empty())
+    {
+      for (uint32_t y = 0; y < mHeight; ++y)
+        for (uint32_t x = 0; x < mWidth; ++x)
+          mCells[Index(x, y)] = (rand() % 100) > ALIVE_PROB;
+
+      return;
+    }
+
+    for (const auto& p : initial)
+    {
+      if (p.X() >= 0 && p.Y() >= 0 && uint32_t(p.X()) < mWidth && uint32_t(p.Y()) < mHeight)
+        mCells[Index(p.X(), p.Y())] = 1;
+    }
+  }
+
+  void Update() override
+  {
+    // Whole vectors are computed up to the padding, which is cleared again
+    // so the border stays dead
+    const uint32_t computed = (mWidth + 31) / 32 * 32;
+
+    mPool.ParallelFor(1, mHeight + 1, BYTE_MAP_GRAIN, [this, computed](size_t begin, size_t end)
+    {
+      for (size_t y = begin; y < end; ++y)
+      {
+        const uint8_t* row = &mCells[y * mStride + 1];
+        uint8_t* out = &mNext[y * mStride + 1];
+        mKernel(row - mStride, row, row + mStride, out, computed, mTables);
+        memset(out + mWidth, 0, mStride - 1 - mWidth);
+
+        mSpans[y - 1] = Difference(row, out, mWidth);
+      }
+    });
+
+    mCells.swap(mNext);
+  }
+
+  void SetRule(const Rule& rule) override
+  {
+    mRule = rule;
+
+    memset(&mTables, 0, sizeof(mTables));
+    for (uint32_t n = 0; n < 9; ++n)
+    {
+      mTables.birth[n] = rule.Next(false, n);
+      mTables.survival[n] = rule.Next(true, n);
+    }
+  }
+
+  bool Alive(uint32_t x, uint32_t y) const override
+  {
+    return mCells[Index(x, y)];
+  }
+
+  void Row(uint32_t y, uint32_t x0, uint32_t count, uint64_t* words) const override
+  {
+    PackBytes(&mCells[Index(0, y)], mWidth, x0, count, words);
+  }
+
+  bool TracksChanges() const override
+  {
+    return true;
+  }
+
+  // The columns of every row that changed, found with a memcmp of the row
+  void ChangedRegions(std::vector<Region>& regions) const override
+  {
+    SpanRegions(mSpans, regions);
+  }
+
+  uint64_t Population() const override
+  {
+    uint64_t population = 0;
+    for (uint8_t cell : mCells)
+      population += cell;
+
+    return population;
+  }
+
+  // Cells are 0 or 1, so a row's count is the sum of its bytes
+  uint64_t CountAlive(uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1) const override
+  {
+    uint64_t population = 0;
+    for (uint32_t y = y0; y < y1; ++y)
+    {
+      const uint8_t* row = &mCells[Index(0, y)];
+      uint32_t sum = 0;
+      for (uint32_t x = x0; x < x1; ++x)
+        sum += row[x];
+
+      population += sum;
+    }
+
+    return population;
+  }
+
+  const char* KernelName() const
+  {
+    return mKernelName;
+  }
+
+private:
+  size_t Index(uint32_t x, uint32_t y) const
+  {
+    return size_t(y + 1) * mStride + x + 1;
+  }
+
+  const uint32_t mWidth;
+  const uint32_t mHeight;
+  const uint32_t mStride;
+
+  std::vector<uint8_t> mCells;
+  std::vector<uint8_t> mNext;
+
+  // Columns of every row that changed in the last generation
+  std::vector<Span> mSpans;
+
+  RuleTables mTables;
+  const char* mKernelName;
+  const RowKernel mKernel;
+
+  ThreadPool mPool;
+};
@@ -0,0 +1,357 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "engine.h"
+
+#define CYCLE_BLOCK 64
+#define CYCLE_MAX_PERIOD 32
+
+// Wraps an engine and watches for the board repeating itself. The board hash
+// is the xor of one hash per block of CYCLE_BLOCK x CYCLE_BLOCK cells, read a
+// row word at a time, and only blocks the engine reports as changed are hashed
+// again. Meant for engines that track changes: those make a settled board
+// almost free to watch, any other would be rehashed whole every generation.
+//
+// A hash seen again within CYCLE_MAX_PERIOD generations starts a candidate
+// cycle of that period. The states of one period are stored while the engine
+// keeps running, and once the hashes repeated for a whole period and the board
+// matches the first stored state exactly, the engine is no longer updated and
+// the stored states are replayed.
+class CycleDetector : public Engine
+{
+public:
+  CycleDetector(std::unique_ptr<Engine> engine)
+    : mEngine(std::move(engine))
+    , mBlocksX((mEngine->Width() + CYCLE_BLOCK - 1) / CYCLE_BLOCK)
+    , mBlocksY((mEngine->Height() + CYCLE_BLOCK - 1) / CYCLE_BLOCK)
+    , mBlockHashes(mBlocksX * mBlocksY, 0)
+    , mMarked(mBlocksX * mBlocksY, 0)
+    , mWords((mEngine->Width() + 63) / 64)
+  {
+    mRule = mEngine->CurrentRule();
+  }
+
+  const char* Name() const override
+  {
+    return mEngine->Name();
+  }
+
+  uint32_t Width() const override
+  {
+    return mEngine->Width();
+  }
+
+  uint32_t Height() const override
+  {
+    return mEngine->Height();
+  }
+
+  void Start(const std::vector<linalg::Int2d>& initial) override
+  {
+    mEngine->Start(initial);
+    Reset();
+  }
+
+  void Update() override
+  {
+    ++mGeneration;
+
+    if (mPeriod)
+    {
+      mPhase = (mPhase + 1) % mPeriod;
+      return;
+    }
+
+    mEngine->Update();
+    Rehash(false);
+    Watch();
+  }
+
+  void SetRule(const Rule& rule) override
+  {
+    mRule = rule;
+    mEngine->SetRule(rule);
+    Reset();
+  }
+
+  bool Alive(uint32_t x, uint32_t y) const override
+  {
+    if (!mPeriod)
+      return mEngine->Alive(x, y);
+
+    return (mStates[mPhase].cells[y * mWords + x / 64] >> (x % 64)) & 1;
+  }
+
+  void Row(uint32_t y, uint32_t x0, uint32_t count, uint64_t* words) const override
+  {
+    if (!mPeriod)
+      mEngine->Row(y, x0, count, words);
+    else
+      CopyBits(&mStates[mPhase].cells[y * mWords], mWords, x0, count, words);
+  }
+
+  bool TracksChanges() const override
+  {
+    return mEngine->TracksChanges();
+  }
+
+  void ChangedRegions(std::vector<Region>& regions) const override
+  {
+    if (!mPeriod)
+    {
+      if (mFresh)
+        regions.push_back({0, 0, Width(), Height()});
+      else
+        mEngine->ChangedRegions(regions);
+      return;
+    }
+
+    // A block changed when its hash differs from the one of the previous phase
+    const auto& now = mStates[mPhase].blockHashes;
+    const auto& before = mStates[(mPhase + mPeriod - 1) % mPeriod].blockHashes;
+    for (uint32_t block = 0; block < now.size(); ++block)
+      if (now[block] != before[block])
+        regions.push_back(BlockRegion(block));
+  }
+
+  uint64_t Population() const override
+  {
+    return mPeriod ? mStates[mPhase].population : mEngine->Population();
+  }
+
+  uint64_t CountAlive(uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1) const override
+  {
+    if (!mPeriod)
+      return mEngine->CountAlive(x0, y0, x1, y1);
+
+    uint64_t population = 0;
+    std::vector<uint64_t> words((x1 - x0 + 63) / 64);
+    for (uint32_t y = y0; y < y1; ++y)
+    {
+      Row(y, x0, x1 - x0, words.data());
+      for (uint64_t word : words)
+        population += __builtin_popcountll(word);
+    }
+
+    return population;
+  }
+
+  // Period of the cycle being replayed, 0 while still simulating
+  uint32_t Period() const
+  {
+    return mPeriod;
+  }
+
+  // Generation at which the cycle was confirmed
+  uint64_t DetectedAt() const
+  {
+    return mDetectedAt;
+  }
+
+  uint64_t Generation() const
+  {
+    return mGeneration;
+  }
+
+  uint64_t Hash() const
+  {
+    return mHash;
+  }
+
+  Engine& Inner()
+  {
+    return *mEngine;
+  }
+
+private:
+  struct State
+  {
+    std::vector<uint64_t> cells;
+    std::vector<uint64_t> blockHashes;
+    uint64_t population = 0;
+  };
+
+  void Reset()
+  {
+    mGeneration = 0;
+    mPeriod = 0;
+    mPhase = 0;
+    mDetectedAt = 0;
+    mCandidate = 0;
+    mStates.clear();
+    mHistory.clear();
+    mHash = 0;
+    std::fill(mBlockHashes.begin(), mBlockHashes.end(), 0);
+
+    Rehash(true);
+    mHistory.push_back(mHash);
+
+    // ChangedRegions() of the engine refer to its last update, the new board has to
+    // be shown as a whole once
+    mFresh = true;
+  }
+
+  void Rehash(bool all)
+  {
+    mFresh = false;
+
+    mRegions.clear();
+    if (all)
+      mRegions.push_back({0, 0, Width(), Height()});
+    else
+      mEngine->ChangedRegions(mRegions);
+
+    // Blocks touched by any region, each hashed once
+    mDirty.clear();
+    for (const Region& region : mRegions)
+    {
+      if (region.x0 >= region.x1 || region.y0 >= region.y1)
+        continue;
+
+      for (uint32_t by = region.y0 / CYCLE_BLOCK; by <= (region.y1 - 1) / CYCLE_BLOCK; ++by)
+      {
+        for (uint32_t bx = region.x0 / CYCLE_BLOCK; bx <= (region.x1 - 1) / CYCLE_BLOCK; ++bx)
+        {
+          const uint32_t block = by * mBlocksX + bx;
+          if (!mMarked[block])
+          {
+            mMarked[block] = 1;
+            mDirty.push_back(block);
+          }
+        }
+      }
+    }
+
+    for (uint32_t index : mDirty)
+    {
+      mMarked[index] = 0;
+
+      const Region r = BlockRegion(index);
+      uint64_t& block = mBlockHashes[index];
+      mHash ^= block;
+      block = HashBlock(index, r.x0, r.y0, r.x1, r.y1);
+      mHash ^= block;
+    }
+  }
+
+  Region BlockRegion(uint32_t block) const
+  {
+    const uint32_t x0 = block % mBlocksX * CYCLE_BLOCK, y0 = block / mBlocksX * CYCLE_BLOCK;
+    return {x0, y0, std::min(Width(), x0 + CYCLE_BLOCK), std::min(Height(), y0 + CYCLE_BLOCK)};
+  }
+
+  uint64_t HashBlock(uint64_t index, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1) const
+  {
+    uint64_t hash = Mix(index + 1);
+    for (uint32_t y = y0; y < y1; ++y)
+    {
+      uint64_t row;
+      mEngine->Row(y, x0, x1 - x0, &row);
+      hash = Mix(hash ^ row);
+    }
+
+    return hash;
+  }
+
+  // splitmix64 finaliser
+  static uint64_t Mix(uint64_t x)
+  {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+  }
+
+  // Compare the new hash with the history and follow the candidate cycle
+  void Watch()
+  {
+    const size_t size = mHistory.size();
+
+    if (mCandidate)
+    {
+      if (mHistory[size - mCandidate] != mHash)
+      {
+        mCandidate = 0;
+        mStates.clear();
+      }
+      else if (mStates.size() < mCandidate)
+      {
+        mStates.push_back(Capture());
+      }
+      else
+      {
+        // A whole period repeated, make sure it is not a hash collision
+        if (Capture().cells == mStates[0].cells)
+        {
+          mPeriod = mCandidate;
+          mPhase = 0;
+          mDetectedAt = mGeneration;
+          mHistory.clear();
+          return;
+        }
+
+        mCandidate = 0;
+        mStates.clear();
+      }
+    }
+
+    if (!mCandidate)
+    {
+      for (uint32_t period = 1; period <= std::min<size_t>(CYCLE_MAX_PERIOD, size); ++period)
+      {
+        if (mHistory[size - period] == mHash)
+        {
+          mCandidate = period;
+          mStates.push_back(Capture());
+          break;
+        }
+      }
+    }
+
+    if (size == CYCLE_MAX_PERIOD)
+      mHistory.erase(mHistory.begin());
+    mHistory.push_back(mHash);
+  }
+
+  State Capture() const
+  {
+    State state;
+    state.cells.assign(Height() * mWords, 0);
+    for (uint32_t y = 0; y < Height(); ++y)
+      mEngine->Row(y, 0, Width(), &state.cells[y * mWords]);
+
+    for (uint64_t word : state.cells)
+      state.population += __builtin_popcountll(word);
+
+    state.blockHashes = mBlockHashes;
+    return state;
+  }
+
+  std::unique_ptr<Engine> mEngine;
+  const uint32_t mBlocksX;
+  const uint32_t mBlocksY;
+
+  uint64_t mHash = 0;
+  std::vector<uint64_t> mBlockHashes;
+  bool mFresh = true;
+
+  // Scratch space of Rehash()
+  std::vector<Region> mRegions;
+  std::vector<uint8_t> mMarked;
+  std::vector<uint32_t> mDirty;
+
+  // Hashes of the last CYCLE_MAX_PERIOD generations, newest last
+  std::vector<uint64_t> mHistory;
+
+  uint32_t mCandidate = 0;
+  uint32_t mPeriod = 0;
+  uint32_t mPhase = 0;
+  uint64_t mGeneration = 0;
+  uint64_t mDetectedAt = 0;
+
+  const uint32_t mWords;
+  std::vector<State> mStates;
+};
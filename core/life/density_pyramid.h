@@ -0,0 +1,169 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "engine.h"
+
+#define PYRAMID_BASE 3
+
+// Live cells per block of 2^k x 2^k cells for every k up to a single block
+// covering the board. Levels from PYRAMID_BASE up are stored, each entry the
+// sum of four entries of the level below; smaller blocks are counted from the
+// engine directly. Update() only recounts base blocks inside the regions the
+// engine reports as changed and the blocks above them, so a generation costs
+// time proportional to what changed and a frame to the texels it reads.
+class DensityPyramid
+{
+public:
+  DensityPyramid(const Engine& engine)
+    : mEngine(engine)
+  {
+    uint32_t width = (engine.Width() + (1 << PYRAMID_BASE) - 1) >> PYRAMID_BASE;
+    uint32_t height = (engine.Height() + (1 << PYRAMID_BASE) - 1) >> PYRAMID_BASE;
+    while (true)
+    {
+      mLevels.push_back({width, height, {}, {}});
+      mLevels.back().counts.assign(size_t(width) * height, 0);
+      mLevels.back().marked.assign(size_t(width) * height, 0);
+
+      // An empty board stops at its first level
+      if (width <= 1 && height <= 1)
+        break;
+
+      width = (width + 1) / 2;
+      height = (height + 1) / 2;
+    }
+  }
+
+  // Level of the block that covers the whole board
+  uint32_t Top() const
+  {
+    return PYRAMID_BASE + mLevels.size() - 1;
+  }
+
+  // Recount after a generation, or everything after a new start
+  void Update(bool all = false)
+  {
+    mChanges.clear();
+    if (all)
+      mChanges.push_back({0, 0, mEngine.Width(), mEngine.Height()});
+    else
+      mEngine.ChangedRegions(mChanges);
+
+    // Base blocks touched by any region, each counted once
+    const uint32_t size = 1 << PYRAMID_BASE;
+    Level& base = mLevels[0];
+
+    mDirty.clear();
+    for (const Region& region : mChanges)
+    {
+      if (region.x0 >= region.x1 || region.y0 >= region.y1)
+        continue;
+
+      for (uint32_t by = region.y0 >> PYRAMID_BASE; by <= (region.y1 - 1) >> PYRAMID_BASE; ++by)
+      {
+        for (uint32_t bx = region.x0 >> PYRAMID_BASE; bx <= (region.x1 - 1) >> PYRAMID_BASE; ++bx)
+        {
+          const uint32_t block = by * base.width + bx;
+          if (!base.marked[block])
+          {
+            base.marked[block] = 1;
+            mDirty.push_back(block);
+          }
+        }
+      }
+    }
+
+    for (uint32_t block : mDirty)
+    {
+      base.marked[block] = 0;
+
+      const uint32_t x0 = block % base.width * size, y0 = block / base.width * size;
+      base.counts[block] = mEngine.CountAlive(x0, y0, std::min(mEngine.Width(), x0 + size), std::min(mEngine.Height(), y0 + size));
+    }
+
+    // Every dirty block makes its parent dirty, each parent is summed once
+    for (size_t l = 1; l < mLevels.size() && !mDirty.empty(); ++l)
+    {
+      const Level& below = mLevels[l - 1];
+      Level& level = mLevels[l];
+
+      mParents.clear();
+      for (uint32_t child : mDirty)
+      {
+        const uint32_t parent = (child / below.width / 2) * level.width + (child % below.width) / 2;
+        if (!level.marked[parent])
+        {
+          level.marked[parent] = 1;
+          mParents.push_back(parent);
+        }
+      }
+
+      for (uint32_t parent : mParents)
+      {
+        level.marked[parent] = 0;
+
+        const uint32_t px = parent % level.width, py = parent / level.width;
+        uint32_t count = 0;
+        for (uint32_t cy = 2 * py; cy < std::min(below.height, 2 * py + 2); ++cy)
+          for (uint32_t cx = 2 * px; cx < std::min(below.width, 2 * px + 2); ++cx)
+            count += below.counts[cy * below.width + cx];
+
+        level.counts[parent] = count;
+      }
+
+      mDirty.swap(mParents);
+    }
+  }
+
+  // Regions that changed in the last Update()
+  const std::vector<Region>& Changes() const
+  {
+    return mChanges;
+  }
+
+  // Live cells in block (bx, by) of size 2^level, 0 outside of the board
+  uint64_t Count(uint32_t level, int64_t bx, int64_t by) const
+  {
+    if (bx < 0 || by < 0)
+      return 0;
+
+    if (level < PYRAMID_BASE)
+    {
+      const uint64_t x0 = uint64_t(bx) << level, y0 = uint64_t(by) << level;
+      if (x0 >= mEngine.Width() || y0 >= mEngine.Height())
+        return 0;
+
+      return mEngine.CountAlive(x0, y0, std::min<uint64_t>(mEngine.Width(), x0 + (1 << level)),
+                                std::min<uint64_t>(mEngine.Height(), y0 + (1 << level)));
+    }
+
+    if (level > Top())
+      return bx == 0 && by == 0 && !mLevels.back().counts.empty() ? mLevels.back().counts[0] : 0;
+
+    const Level& l = mLevels[level - PYRAMID_BASE];
+    if (bx >= l.width || by >= l.height)
+      return 0;
+
+    return l.counts[by * l.width + bx];
+  }
+
+private:
+  struct Level
+  {
+    uint32_t width;
+    uint32_t height;
+    std::vector<uint32_t> counts;
+    std::vector<uint8_t> marked;
+  };
+
+  const Engine& mEngine;
+  std::vector<Level> mLevels;
+  std::vector<Region> mChanges;
+
+  // Scratch space of Update()
+  std::vector<uint32_t> mDirty;
+  std::vector<uint32_t> mParents;
+};
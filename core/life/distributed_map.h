@@ -0,0 +1,757 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "byte_map.h"
+#include "engine.h"
+
+#define DISTRIBUTED_WORKERS 4
+
+namespace distributed
+{
+// Requests from the coordinator, each worker answers in the same order
+enum Op : uint32_t
+{
+  START_RANDOM, // followed by the subdomain's rows of cells
+  START_CELLS,  // a = number of cells, followed by their local x and y
+  RULE,         // a = birth, b = survival
+  STEP,         // answered with a Report
+  SNAPSHOT,     // answered with the subdomain's rows [a, b) of cells
+  QUIT
+};
+
+struct Command
+{
+  uint32_t op;
+  uint32_t a;
+  uint32_t b;
+};
+
+// Population after a step and the local rows [first, end) that changed in it
+struct Report
+{
+  uint64_t population;
+  uint32_t first;
+  uint32_t end;
+};
+
+// Blocking transfers that survive partial writes and signals
+inline bool SendAll(int fd, const void* data, size_t size)
+{
+  const uint8_t* p = static_cast<const uint8_t*>(data);
+  while (size > 0)
+  {
+    const ssize_t sent = send(fd, p, size, MSG_NOSIGNAL);
+    if (sent < 0 && errno == EINTR)
+      continue;
+    if (sent <= 0)
+      return false;
+
+    p += sent;
+    size -= sent;
+  }
+
+  return true;
+}
+
+inline bool ReceiveAll(int fd, void* data, size_t size)
+{
+  uint8_t* p = static_cast<uint8_t*>(data);
+  while (size > 0)
+  {
+    const ssize_t received = recv(fd, p, size, 0);
+    if (received < 0 && errno == EINTR)
+      continue;
+    if (received <= 0)
+      return false;
+
+    p += received;
+    size -= received;
+  }
+
+  return true;
+}
+
+// One halo sent to and received from a neighbour
+struct Transfer
+{
+  int fd;
+  const uint8_t* out;
+  uint8_t* in;
+  size_t size;
+  size_t sent;
+  size_t received;
+};
+
+// Runs all transfers at once so no pair of neighbours can block each other
+// on full socket buffers
+inline bool Exchange(std::vector<Transfer>& transfers)
+{
+  std::vector<pollfd> fds(transfers.size());
+  while (true)
+  {
+    size_t pending = 0;
+    for (size_t i = 0; i < transfers.size(); ++i)
+    {
+      const Transfer& t = transfers[i];
+      fds[i] = {t.fd, short((t.sent < t.size ? POLLOUT : 0) | (t.received < t.size ? POLLIN : 0)), 0};
+      pending += fds[i].events != 0;
+    }
+
+    if (pending == 0)
+      return true;
+
+    if (poll(fds.data(), fds.size(), -1) < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+
+    for (size_t i = 0; i < transfers.size(); ++i)
+    {
+      Transfer& t = transfers[i];
+      if (fds[i].revents & (POLLERR | POLLNVAL))
+        return false;
+
+      if (fds[i].revents & POLLOUT)
+      {
+        const ssize_t sent = send(t.fd, t.out + t.sent, t.size - t.sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent < 0 && errno != EAGAIN && errno != EINTR)
+          return false;
+        t.sent += std::max<ssize_t>(sent, 0);
+      }
+
+      if (fds[i].revents & (POLLIN | POLLHUP))
+      {
+        const ssize_t received = recv(t.fd, t.in + t.received, t.size - t.received, MSG_DONTWAIT);
+        if (received == 0 || (received < 0 && errno != EAGAIN && errno != EINTR))
+          return false;
+        t.received += std::max<ssize_t>(received, 0);
+      }
+    }
+  }
+}
+
+// Columns [x0, x1) and rows [y0, y1) of the board owned by one worker
+struct Subdomain
+{
+  uint32_t x0, y0, x1, y1;
+};
+
+// The state of one worker process: its subdomain one byte per cell, with a
+// ring of halo cells copied from the neighbouring subdomains every generation.
+// Halos along the board's edges stay dead.
+class Worker
+{
+public:
+  enum { NORTH, SOUTH, WEST, EAST };
+
+  Worker(const Subdomain& domain, int control, const int neighbours[4])
+    : mWidth(domain.x1 - domain.x0)
+    , mHeight(domain.y1 - domain.y0)
+    , mStride(mWidth + 2)
+    , mCells((mHeight + 2) * mStride, 0)
+    , mNext((mHeight + 2) * mStride, 0)
+    , mWest(mHeight + 2)
+    , mEast(mHeight + 2)
+    , mColumnIn(2 * (mHeight + 2))
+    , mControl(control)
+    , mKernel(SelectRowKernel())
+  {
+    std::copy(neighbours, neighbours + 4, mNeighbours);
+    SetRule(Rule());
+  }
+
+  // Serve the coordinator until it quits or goes away
+  void Run()
+  {
+    Command command;
+    while (ReceiveAll(mControl, &command, sizeof(command)))
+    {
+      switch (command.op)
+      {
+        case START_RANDOM:
+          std::fill(mCells.begin(), mCells.end(), 0);
+          for (uint32_t y = 0; y < mHeight; ++y)
+            if (!ReceiveAll(mControl, &mCells[Index(0, y)], mWidth))
+              return;
+          break;
+
+        case START_CELLS:
+        {
+          std::fill(mCells.begin(), mCells.end(), 0);
+          std::vector<uint32_t> cells(2 * size_t(command.a));
+          if (!ReceiveAll(mControl, cells.data(), cells.size() * sizeof(uint32_t)))
+            return;
+
+          for (size_t i = 0; i < cells.size(); i += 2)
+            mCells[Index(cells[i], cells[i + 1])] = 1;
+          break;
+        }
+
+        case RULE:
+          SetRule(Rule(command.a, command.b));
+          break;
+
+        case STEP:
+        {
+          Report report;
+          if (!Step(report) || !SendAll(mControl, &report, sizeof(report)))
+            return;
+          break;
+        }
+
+        case SNAPSHOT:
+          for (uint32_t y = command.a; y < std::min(command.b, mHeight); ++y)
+            if (!SendAll(mControl, &mCells[Index(0, y)], mWidth))
+              return;
+          break;
+
+        default:
+          return;
+      }
+    }
+  }
+
+private:
+  size_t Index(uint32_t x, uint32_t y) const
+  {
+    return size_t(y + 1) * mStride + x + 1;
+  }
+
+  void SetRule(const Rule& rule)
+  {
+    memset(&mTables, 0, sizeof(mTables));
+    for (uint32_t n = 0; n < 9; ++n)
+    {
+      mTables.birth[n] = rule.Next(false, n);
+      mTables.survival[n] = rule.Next(true, n);
+    }
+  }
+
+  bool Step(Report& report)
+  {
+    if (!ExchangeHalos())
+      return false;
+
+    report.population = 0;
+    report.first = report.end = 0;
+    for (uint32_t y = 0; y < mHeight; ++y)
+    {
+      const uint8_t* row = &mCells[Index(0, y)];
+      uint8_t* out = &mNext[Index(0, y)];
+      mKernel(row - mStride, row, row + mStride, out, mWidth, mTables);
+
+      if (memcmp(row, out, mWidth))
+      {
+        report.first = report.end == 0 ? y : report.first;
+        report.end = y + 1;
+      }
+
+      for (uint32_t x = 0; x < mWidth; ++x)
+        report.population += out[x];
+    }
+
+    mCells.swap(mNext);
+    return true;
+  }
+
+  // Rows go north and south first, then whole columns including the halo rows
+  // just received go west and east, which also brings in the corner cells of
+  // the diagonal neighbours
+  bool ExchangeHalos()
+  {
+    mTransfers.clear();
+    if (mNeighbours[NORTH] >= 0)
+      mTransfers.push_back({mNeighbours[NORTH], &mCells[Index(0, 0)], &mCells[1], mWidth, 0, 0});
+    if (mNeighbours[SOUTH] >= 0)
+      mTransfers.push_back({mNeighbours[SOUTH], &mCells[Index(0, mHeight - 1)], &mCells[(mHeight + 1) * mStride + 1], mWidth, 0, 0});
+
+    if (!Exchange(mTransfers))
+      return false;
+
+    // Columns are strided, so they go through scratch space
+    mTransfers.clear();
+    if (mNeighbours[WEST] >= 0)
+    {
+      for (uint32_t y = 0; y < mHeight + 2; ++y)
+        mWest[y] = mCells[y * mStride + 1];
+      mTransfers.push_back({mNeighbours[WEST], mWest.data(), &mColumnIn[0], mHeight + 2, 0, 0});
+    }
+    if (mNeighbours[EAST] >= 0)
+    {
+      for (uint32_t y = 0; y < mHeight + 2; ++y)
+        mEast[y] = mCells[y * mStride + mWidth];
+      mTransfers.push_back({mNeighbours[EAST], mEast.data(), &mColumnIn[mHeight + 2], mHeight + 2, 0, 0});
+    }
+
+    if (!Exchange(mTransfers))
+      return false;
+
+    for (uint32_t y = 0; y < mHeight + 2; ++y)
+    {
+      if (mNeighbours[WEST] >= 0)
+        mCells[y * mStride] = mColumnIn[y];
+      if (mNeighbours[EAST] >= 0)
+        mCells[y * mStride + mWidth + 1] = mColumnIn[mHeight + 2 + y];
+    }
+
+    return true;
+  }
+
+  const uint32_t mWidth;
+  const uint32_t mHeight;
+  const uint32_t mStride;
+
+  std::vector<uint8_t> mCells;
+  std::vector<uint8_t> mNext;
+  std::vector<uint8_t> mWest;
+  std::vector<uint8_t> mEast;
+  std::vector<uint8_t> mColumnIn;
+  std::vector<Transfer> mTransfers;
+
+  const int mControl;
+  int mNeighbours[4];
+
+  RuleTables mTables;
+  const RowKernel mKernel;
+};
+} // namespace distributed
+
+// The board cut in a grid of rectangular subdomains, each advanced by its own
+// worker process forked at construction. Neighbouring workers swap one cell
+// wide halos over Unix socket pairs every generation without going through
+// this process, which only acts as coordinator: it starts every generation,
+// sums the populations the workers report and keeps track of the rows of
+// every subdomain that changed.
+//
+// The whole board only exists here as a snapshot, gathered when cells are read
+// after an Update() and only for the rows that changed since the last one.
+// Running headless only ever moves the halos and the reports.
+class DistributedMap : public Engine
+{
+public:
+  DistributedMap(uint32_t width, uint32_t height, unsigned workers = DISTRIBUTED_WORKERS)
+    : mWidth(width)
+    , mHeight(height)
+  {
+    if (workers == 0)
+      workers = std::max(1u, std::thread::hardware_concurrency());
+
+    Split(workers);
+    Spawn();
+
+    mReports.resize(mDomains.size());
+    mStale.resize(mDomains.size());
+    ChangeAll();
+  }
+
+  ~DistributedMap()
+  {
+    const distributed::Command quit{distributed::QUIT, 0, 0};
+    for (int fd : mControls)
+    {
+      distributed::SendAll(fd, &quit, sizeof(quit));
+      close(fd);
+    }
+
+    for (pid_t pid : mPids)
+      waitpid(pid, nullptr, 0);
+  }
+
+  DistributedMap(const DistributedMap&) = delete;
+  DistributedMap& operator=(const DistributedMap&) = delete;
+
+  const char* Name() const override
+  {
+    return "distributed";
+  }
+
+  uint32_t Width() const override
+  {
+    return mWidth;
+  }
+
+  uint32_t Height() const override
+  {
+    return mHeight;
+  }
+
+  void Start(const std::vector<linalg::Int2d>& initial) override
+  {
+    mPopulation = 0;
+
+    if (initial.empty())
+    {
+      const distributed::Command start{distributed::START_RANDOM, 0, 0};
+
+      // Drawn row by row over the whole board like every other engine, each
+      // row cut between the workers of its band
+      std::vector<uint8_t> row(mWidth);
+      for (int fd : mControls)
+        Expect(distributed::SendAll(fd, &start, sizeof(start)));
+
+      for (uint32_t y = 0; y < mHeight; ++y)
+      {
+        for (uint32_t x = 0; x < mWidth; ++x)
+        {
+          row[x] = (rand() % 100) > ALIVE_PROB;
+          mPopulation += row[x];
+        }
+
+        const uint32_t band = Band(y);
+        for (uint32_t i = 0; i < mColumns; ++i)
+        {
+          const distributed::Subdomain& domain = mDomains[band * mColumns + i];
+          Expect(distributed::SendAll(mControls[band * mColumns + i], &row[domain.x0], domain.x1 - domain.x0));
+        }
+      }
+    }
+    else
+    {
+      // Cells per worker in local coordinates, duplicates dropped so they can
+      // be counted
+      std::vector<std::vector<uint64_t>> cells(mDomains.size());
+      for (const auto& p : initial)
+      {
+        if (p.X() < 0 || p.Y() < 0 || uint32_t(p.X()) >= mWidth || uint32_t(p.Y()) >= mHeight)
+          continue;
+
+        const uint32_t i = Band(p.Y()) * mColumns + Column(p.X());
+        cells[i].push_back(uint64_t(p.Y() - mDomains[i].y0) << 32 | uint32_t(p.X() - mDomains[i].x0));
+      }
+
+      std::vector<uint32_t> local;
+      for (size_t i = 0; i < mDomains.size(); ++i)
+      {
+        std::sort(cells[i].begin(), cells[i].end());
+        cells[i].erase(std::unique(cells[i].begin(), cells[i].end()), cells[i].end());
+        mPopulation += cells[i].size();
+
+        local.clear();
+        for (uint64_t cell : cells[i])
+        {
+          local.push_back(uint32_t(cell));
+          local.push_back(uint32_t(cell >> 32));
+        }
+
+        const distributed::Command start{distributed::START_CELLS, uint32_t(cells[i].size()), 0};
+        Expect(distributed::SendAll(mControls[i], &start, sizeof(start)));
+        Expect(distributed::SendAll(mControls[i], local.data(), local.size() * sizeof(uint32_t)));
+      }
+    }
+
+    ChangeAll();
+  }
+
+  void Update() override
+  {
+    const distributed::Command step{distributed::STEP, 0, 0};
+    for (int fd : mControls)
+      Expect(distributed::SendAll(fd, &step, sizeof(step)));
+
+    mPopulation = 0;
+    for (size_t i = 0; i < mDomains.size(); ++i)
+    {
+      Expect(distributed::ReceiveAll(mControls[i], &mReports[i], sizeof(mReports[i])));
+      mPopulation += mReports[i].population;
+
+      const distributed::Report& report = mReports[i];
+      Rows& stale = mStale[i];
+      if (report.first < report.end)
+      {
+        stale.first = stale.first < stale.end ? std::min(stale.first, report.first) : report.first;
+        stale.end = std::max(stale.end, report.end);
+      }
+    }
+  }
+
+  void SetRule(const Rule& rule) override
+  {
+    mRule = rule;
+
+    const distributed::Command command{distributed::RULE, rule.Birth(), rule.Survival()};
+    for (int fd : mControls)
+      Expect(distributed::SendAll(fd, &command, sizeof(command)));
+
+    // The cells stay as they are, only the next generation differs
+    for (size_t i = 0; i < mDomains.size(); ++i)
+    {
+      mReports[i].first = 0;
+      mReports[i].end = mDomains[i].y1 - mDomains[i].y0;
+    }
+  }
+
+  bool Alive(uint32_t x, uint32_t y) const override
+  {
+    Gather();
+    return mSnapshot[size_t(y) * mWidth + x];
+  }
+
+  void Row(uint32_t y, uint32_t x0, uint32_t count, uint64_t* words) const override
+  {
+    Gather();
+    PackBytes(&mSnapshot[size_t(y) * mWidth], mWidth, x0, count, words);
+  }
+
+  bool TracksChanges() const override
+  {
+    return true;
+  }
+
+  // The rows every worker reported as changed
+  void ChangedRegions(std::vector<Region>& regions) const override
+  {
+    for (size_t i = 0; i < mDomains.size(); ++i)
+    {
+      const distributed::Subdomain& domain = mDomains[i];
+      if (mReports[i].first < mReports[i].end)
+        regions.push_back({domain.x0, domain.y0 + mReports[i].first, domain.x1, domain.y0 + mReports[i].end});
+    }
+  }
+
+  // From the snapshot, which only pulls the rows that changed
+  uint64_t CountAlive(uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1) const override
+  {
+    Gather();
+
+    uint64_t population = 0;
+    for (uint32_t y = y0; y < y1; ++y)
+    {
+      const uint8_t* row = &mSnapshot[size_t(y) * mWidth];
+      uint32_t sum = 0;
+      for (uint32_t x = x0; x < x1; ++x)
+        sum += row[x];
+
+      population += sum;
+    }
+
+    return population;
+  }
+
+  uint64_t Population() const override
+  {
+    return mPopulation;
+  }
+
+  uint32_t Workers() const
+  {
+    return mDomains.size();
+  }
+
+private:
+  // Rows [first, end) of a subdomain
+  struct Rows
+  {
+    uint32_t first;
+    uint32_t end;
+  };
+
+  // After new cells every subdomain has changed and the snapshot is out of date
+  void ChangeAll()
+  {
+    for (size_t i = 0; i < mDomains.size(); ++i)
+    {
+      const uint32_t rows = mDomains[i].y1 - mDomains[i].y0;
+      mReports[i].first = 0;
+      mReports[i].end = rows;
+      mStale[i] = {0, rows};
+    }
+  }
+
+  // The grid of subdomains for the given number of workers whose cells are
+  // closest to square, with every subdomain at least one cell wide and high
+  void Split(unsigned workers)
+  {
+    mColumns = 1;
+    mBands = 1;
+    double best = -1;
+    for (uint32_t columns = 1; columns <= workers; ++columns)
+    {
+      if (workers % columns || columns > mWidth || workers / columns > mHeight)
+        continue;
+
+      const double aspect = (double(mWidth) / columns) / (double(mHeight) / (workers / columns));
+      const double skew = std::max(aspect, 1 / aspect);
+      if (best < 0 || skew < best)
+      {
+        best = skew;
+        mColumns = columns;
+        mBands = workers / columns;
+      }
+    }
+
+    for (uint32_t band = 0; band < mBands; ++band)
+      for (uint32_t column = 0; column < mColumns; ++column)
+        mDomains.push_back({uint32_t(uint64_t(mWidth) * column / mColumns), uint32_t(uint64_t(mHeight) * band / mBands),
+                            uint32_t(uint64_t(mWidth) * (column + 1) / mColumns), uint32_t(uint64_t(mHeight) * (band + 1) / mBands)});
+  }
+
+  // Socket pairs to every worker and between neighbours, then one fork per
+  // worker that keeps only its own ends
+  void Spawn()
+  {
+    using distributed::Worker;
+
+    const size_t count = mDomains.size();
+    std::vector<int> control(2 * count);
+    std::vector<int> links(4 * count, -1);
+
+    for (size_t i = 0; i < count; ++i)
+      Expect(socketpair(AF_UNIX, SOCK_STREAM, 0, &control[2 * i]) == 0);
+
+    for (uint32_t band = 0; band < mBands; ++band)
+    {
+      for (uint32_t column = 0; column < mColumns; ++column)
+      {
+        const size_t i = band * mColumns + column;
+        int pair[2];
+        if (column + 1 < mColumns)
+        {
+          Expect(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0);
+          links[4 * i + Worker::EAST] = pair[0];
+          links[4 * (i + 1) + Worker::WEST] = pair[1];
+        }
+
+        if (band + 1 < mBands)
+        {
+          Expect(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0);
+          links[4 * i + Worker::SOUTH] = pair[0];
+          links[4 * (i + mColumns) + Worker::NORTH] = pair[1];
+        }
+      }
+    }
+
+    // Nothing buffered for stdout may be flushed twice by the children
+    fflush(nullptr);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+      const pid_t pid = fork();
+      Expect(pid >= 0);
+
+      if (pid == 0)
+      {
+        for (size_t j = 0; j < count; ++j)
+        {
+          close(control[2 * j]);
+          if (j != i)
+            close(control[2 * j + 1]);
+        }
+
+        for (size_t j = 0; j < links.size(); ++j)
+          if (j / 4 != i && links[j] >= 0)
+            close(links[j]);
+
+        {
+          Worker worker(mDomains[i], control[2 * i + 1], &links[4 * i]);
+          worker.Run();
+        }
+        _exit(0);
+      }
+
+      mPids.push_back(pid);
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+      close(control[2 * i + 1]);
+      mControls.push_back(control[2 * i]);
+    }
+
+    for (int fd : links)
+      if (fd >= 0)
+        close(fd);
+  }
+
+  // Bring the snapshot up to date with the workers whose subdomain changed
+  void Gather() const
+  {
+    if (mSnapshot.empty())
+      mSnapshot.assign(size_t(mWidth) * mHeight, 0);
+
+    for (size_t i = 0; i < mDomains.size(); ++i)
+    {
+      if (mStale[i].first >= mStale[i].end)
+        continue;
+
+      const distributed::Command snapshot{distributed::SNAPSHOT, mStale[i].first, mStale[i].end};
+      Expect(distributed::SendAll(mControls[i], &snapshot, sizeof(snapshot)));
+    }
+
+    for (size_t i = 0; i < mDomains.size(); ++i)
+    {
+      if (mStale[i].first >= mStale[i].end)
+        continue;
+
+      const distributed::Subdomain& domain = mDomains[i];
+      for (uint32_t y = domain.y0 + mStale[i].first; y < domain.y0 + mStale[i].end; ++y)
+        Expect(distributed::ReceiveAll(mControls[i], &mSnapshot[size_t(y) * mWidth + domain.x0], domain.x1 - domain.x0));
+
+      mStale[i] = {0, 0};
+    }
+  }
+
+  uint32_t Band(uint32_t y) const
+  {
+    return Part(y, mHeight, mBands);
+  }
+
+  uint32_t Column(uint32_t x) const
+  {
+    return Part(x, mWidth, mColumns);
+  }
+
+  // Which of `parts` pieces starting at size * i / parts holds v
+  static uint32_t Part(uint32_t v, uint32_t size, uint32_t parts)
+  {
+    uint32_t i = uint64_t(v) * parts / size;
+    while (i > 0 && uint64_t(size) * i / parts > v)
+      --i;
+    while (i + 1 < parts && uint64_t(size) * (i + 1) / parts <= v)
+      ++i;
+
+    return i;
+  }
+
+  // A worker that stopped answering leaves the board in an unknown state
+  static void Expect(bool ok)
+  {
+    if (ok)
+      return;
+
+    perror("distributed game of life");
+    abort();
+  }
+
+  const uint32_t mWidth;
+  const uint32_t mHeight;
+
+  uint32_t mColumns = 1;
+  uint32_t mBands = 1;
+  std::vector<distributed::Subdomain> mDomains;
+
+  std::vector<pid_t> mPids;
+  std::vector<int> mControls;
+
+  // Last report of every worker and the sum of their populations
+  std::vector<distributed::Report> mReports;
+  uint64_t mPopulation = 0;
+
+  // Local rows of every subdomain that changed since the snapshot was gathered
+  mutable std::vector<uint8_t> mSnapshot;
+  mutable std::vector<Rows> mStale;
+};
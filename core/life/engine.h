@@ -0,0 +1,169 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "linalg.h"
+#include "rule.h"
+
+#define ALIVE_PROB 50
+
+// Cells in columns [x0, x1) and rows [y0, y1)
+struct Region
+{
+  uint32_t x0, y0, x1, y1;
+};
+
+// Columns [first, end) of one row, empty when first == end
+struct Span
+{
+  uint32_t first, end;
+};
+
+// Common interface of the Game of Life implementations. Cells outside of the
+// board are always dead.
+class Engine
+{
+public:
+  virtual ~Engine() = default;
+
+  virtual const char* Name() const = 0;
+
+  virtual uint32_t Width() const = 0;
+  virtual uint32_t Height() const = 0;
+
+  // Seed the board with the given cells, or randomly with ALIVE_PROB when empty.
+  // Random boards draw one rand() per cell in row major order, so every engine
+  // produces the same board from the same seed.
+  virtual void Start(const std::vector<linalg::Int2d>& initial) = 0;
+
+  // Advance one generation
+  virtual void Update() = 0;
+
+  // Rule of the following generations, Conway's B3/S23 until set
+  virtual void SetRule(const Rule& rule)
+  {
+    mRule = rule;
+  }
+
+  const Rule& CurrentRule() const
+  {
+    return mRule;
+  }
+
+  virtual bool Alive(uint32_t x, uint32_t y) const = 0;
+
+  // Cells [x0, x0 + count) of row y packed 64 to a word, bit i of words[k]
+  // holding column x0 + 64 * k + i. Cells past the board are dead.
+  virtual void Row(uint32_t y, uint32_t x0, uint32_t count, uint64_t* words) const
+  {
+    std::fill(words, words + (count + 63) / 64, 0);
+    for (uint32_t i = 0; i < count && x0 + i < Width(); ++i)
+      words[i / 64] |= uint64_t(Alive(x0 + i, y)) << (i % 64);
+  }
+
+  // Whether the engine knows which cells an Update() changed. Engines that do
+  // not may have changed any cell in every generation.
+  virtual bool TracksChanges() const
+  {
+    return false;
+  }
+
+  // Append regions covering every cell that may have changed in the last
+  // Update(), the whole board when changes are not tracked
+  virtual void ChangedRegions(std::vector<Region>& regions) const
+  {
+    regions.push_back({0, 0, Width(), Height()});
+  }
+
+  virtual uint64_t Population() const
+  {
+    return CountAlive(0, 0, Width(), Height());
+  }
+
+  // Live cells in columns [x0, x1) and rows [y0, y1)
+  virtual uint64_t CountAlive(uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1) const
+  {
+    uint64_t population = 0;
+    for (uint32_t y = y0; y < y1; ++y)
+      for (uint32_t x = x0; x < x1; ++x)
+        population += Alive(x, y);
+
+    return population;
+  }
+
+protected:
+  // Columns in which two rows of `size` bytes differ
+  static Span Difference(const uint8_t* before, const uint8_t* after, uint32_t size)
+  {
+    if (!memcmp(before, after, size))
+      return {0, 0};
+
+    uint32_t first = 0, end = size;
+    while (before[first] == after[first])
+      ++first;
+    while (before[end - 1] == after[end - 1])
+      --end;
+
+    return {first, end};
+  }
+
+  // ChangedRegions() out of the changed span of every row. Spans of
+  // neighbouring rows that overlap are merged into one region.
+  static void SpanRegions(const std::vector<Span>& rows, std::vector<Region>& regions)
+  {
+    bool open = false;
+    Region region{0, 0, 0, 0};
+    for (uint32_t y = 0; y < rows.size(); ++y)
+    {
+      const Span& span = rows[y];
+      const bool empty = span.first >= span.end;
+      if (open && !empty && span.first <= region.x1 && span.end >= region.x0)
+      {
+        region.x0 = std::min(region.x0, span.first);
+        region.x1 = std::max(region.x1, span.end);
+        region.y1 = y + 1;
+        continue;
+      }
+
+      if (open)
+        regions.push_back(region);
+
+      open = !empty;
+      region = {span.first, y, span.end, y + 1};
+    }
+
+    if (open)
+      regions.push_back(region);
+  }
+
+  // Row() out of a row of `size` words packed like Row() itself
+  static void CopyBits(const uint64_t* row, uint32_t size, uint32_t x0, uint32_t count, uint64_t* words)
+  {
+    const uint32_t first = x0 / 64, shift = x0 % 64;
+    for (uint32_t k = 0; k < (count + 63) / 64; ++k)
+    {
+      const uint32_t i = first + k;
+      uint64_t word = i < size ? row[i] >> shift : 0;
+      if (shift && i + 1 < size)
+        word |= row[i + 1] << (64 - shift);
+
+      words[k] = word;
+    }
+
+    if (count % 64)
+      words[count / 64] &= (uint64_t(1) << (count % 64)) - 1;
+  }
+
+  // Row() out of a row of `size` cells stored one per byte as 0 or 1
+  static void PackBytes(const uint8_t* row, uint32_t size, uint32_t x0, uint32_t count, uint64_t* words)
+  {
+    std::fill(words, words + (count + 63) / 64, 0);
+    for (uint32_t i = 0; i < count && x0 + i < size; ++i)
+      words[i / 64] |= uint64_t(row[x0 + i]) << (i % 64);
+  }
+
+  Rule mRule;
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstring>
+#include <memory>
+
+#include "bit_map.h"
+#include "byte_map.h"
+#include "hashlife.h"
+#include "map.h"
+
+// Worker processes need fork(), which the web build does not have
+#if !defined(__EMSCRIPTEN__)
+#include "distributed_map.h"
+
+#define ENGINES "map, bytemap, bitmap, hashlife, distributed"
+
+static const char* const ENGINE_NAMES[] = {"map", "bytemap", "bitmap", "hashlife", "distributed"};
+#else
+#define ENGINES "map, bytemap, bitmap, hashlife"
+
+static const char* const ENGINE_NAMES[] = {"map", "bytemap", "bitmap", "hashlife"};
+#endif
+
+// Largest board side of the engines: map keeps 16 bit coordinates and int cell
+// indices, the others 32 bit block indices in the density pyramid
+#define MAP_SIZE_LIMIT 32767
+#define ENGINE_SIZE_LIMIT (1u << 18)
+
+inline uint32_t MaxEngineSize(const char* name)
+{
+  return !strcmp(name, "map") ? MAP_SIZE_LIMIT : ENGINE_SIZE_LIMIT;
+}
+
+// Engine by name, nullptr when the name is unknown. Threads are only used by
+// the engines that support them, 0 means one per core.
+inline std::unique_ptr<Engine> MakeEngine(const char* name, uint32_t width, uint32_t height, unsigned threads = 1)
+{
+  if (!strcmp(name, "map"))
+    return std::unique_ptr<Engine>(new Map(width, height));
+
+  if (!strcmp(name, "bytemap"))
+    return std::unique_ptr<Engine>(new ByteMap(width, height, threads));
+
+  if (!strcmp(name, "bitmap"))
+    return std::unique_ptr<Engine>(new BitMap(width, height, threads));
+
+  if (!strcmp(name, "hashlife"))
+    return std::unique_ptr<Engine>(new Hashlife(width, height));
+
+#if !defined(__EMSCRIPTEN__)
+  // Threads are worker processes here, and the board is always split
+  if (!strcmp(name, "distributed"))
+    return std::unique_ptr<Engine>(new DistributedMap(width, height, threads == 1 ? DISTRIBUTED_WORKERS : threads));
+#endif
+
+  return nullptr;
+}
@@ -0,0 +1,716 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include "engine.h"
+
+#define HASHLIFE_MEMORY_MB 512
+
+// Changes are reported in tiles of 2^HASHLIFE_TILE cells per side
+#define HASHLIFE_TILE 6
+
+// Gosper's Hashlife. The board is a quadtree of canonical nodes, identical
+// subtrees are shared, and every node memoises the centre of its future, so
+// repetitive patterns can be advanced by 2^step generations in one go and be
+// much larger than the board of the other engines.
+//
+// The quadtree itself is an unbounded plane. After every Update() the cells
+// that left the board are dropped, which matches the other engines exactly for
+// single generations; larger steps only match while the pattern stays away
+// from the board edges.
+//
+// The root is never smaller than four tiles, which keeps its origin on the
+// tile grid. Every tile then is a node of both the previous and the current
+// tree, and since nodes are canonical the tiles that changed are found by
+// following only the subtrees the two trees do not share.
+class Hashlife : public Engine
+{
+public:
+  Hashlife(uint32_t width, uint32_t height, size_t memoryBytes = size_t(HASHLIFE_MEMORY_MB) << 20)
+    : mWidth(width)
+    , mHeight(height)
+    , mMaxNodes(memoryBytes / sizeof(Node))
+    , mTilesX((width + (1 << HASHLIFE_TILE) - 1) >> HASHLIFE_TILE)
+    , mTileMarks(size_t(mTilesX) * ((height + (1 << HASHLIFE_TILE) - 1) >> HASHLIFE_TILE), 0)
+  {
+    mDead.population = 0;
+    mAlive.population = 1;
+    mBuckets.assign(1 << 16, nullptr);
+    Clear();
+  }
+
+  Hashlife(const Hashlife&) = delete;
+  Hashlife& operator=(const Hashlife&) = delete;
+
+  const char* Name() const override
+  {
+    return "hashlife";
+  }
+
+  uint32_t Width() const override
+  {
+    return mWidth;
+  }
+
+  uint32_t Height() const override
+  {
+    return mHeight;
+  }
+
+  void Start(const std::vector<linalg::Int2d>& initial) override
+  {
+    Clear();
+
+    if (!initial.empty())
+    {
+      for (const auto& p : initial)
+      {
+        if (p.X() >= 0 && p.Y() >= 0 && uint32_t(p.X()) < mWidth && uint32_t(p.Y()) < mHeight)
+          Set(p.X(), p.Y(), true);
+      }
+
+      return;
+    }
+
+    const uint64_t stride = (mWidth + 63) / 64;
+    std::vector<uint64_t> rows(stride * mHeight, 0);
+    for (uint32_t y = 0; y < mHeight; ++y)
+    {
+      for (uint32_t x = 0; x < mWidth; ++x)
+      {
+        if ((rand() % 100) > ALIVE_PROB)
+          rows[y * stride + x / 64] |= uint64_t(1) << (x % 64);
+      }
+    }
+
+    uint8_t level = mRoot->level;
+    while ((uint64_t(1) << level) < std::max(mWidth, mHeight))
+      ++level;
+
+    mRoot = Build(level, 0, 0, rows, stride);
+  }
+
+  // Advance 2^Step() generations
+  void Update() override
+  {
+    if (mNodes > mMaxNodes)
+      Collect();
+
+    mPrevious = mRoot;
+    mPreviousX = mOriginX;
+    mPreviousY = mOriginY;
+    mFresh = false;
+
+    // The pattern has to sit in the centre half of the root with a margin of at
+    // least 2^step cells, and the root one level above the step
+    while (mRoot->level < mStep + 2 || !Centred(mRoot))
+      Expand();
+
+    // The successor of the padded root covers the same square as the root
+    mRoot = Successor(Pad(mRoot), mStep);
+    mGeneration += uint64_t(1) << mStep;
+
+    mRoot = Clip(mRoot, mOriginX, mOriginY);
+    Crop();
+  }
+
+  bool Alive(uint32_t x, uint32_t y) const override
+  {
+    int64_t px = int64_t(x) - mOriginX;
+    int64_t py = int64_t(y) - mOriginY;
+    const int64_t size = int64_t(1) << mRoot->level;
+    if (x >= mWidth || y >= mHeight || px < 0 || py < 0 || px >= size || py >= size)
+      return false;
+
+    const Node* node = mRoot;
+    while (node->level > 0)
+    {
+      const int64_t half = int64_t(1) << (node->level - 1);
+      const bool east = px >= half;
+      const bool south = py >= half;
+      node = south ? (east ? node->se : node->sw) : (east ? node->ne : node->nw);
+      px -= east ? half : 0;
+      py -= south ? half : 0;
+    }
+
+    return node->population;
+  }
+
+  void Row(uint32_t y, uint32_t x0, uint32_t count, uint64_t* words) const override
+  {
+    std::fill(words, words + (count + 63) / 64, 0);
+    if (y < mHeight)
+      Bits(mRoot, mOriginX, mOriginY, y, x0, std::min<int64_t>(int64_t(x0) + count, mWidth), words);
+  }
+
+  uint64_t Population() const override
+  {
+    return mRoot->population;
+  }
+
+  // Whole nodes inside the range are taken from their population
+  uint64_t CountAlive(uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1) const override
+  {
+    return Count(mRoot, mOriginX, mOriginY, x0, y0, x1, y1);
+  }
+
+  bool TracksChanges() const override
+  {
+    return true;
+  }
+
+  void ChangedRegions(std::vector<Region>& regions) const override
+  {
+    if (mFresh || !mPrevious)
+    {
+      regions.push_back({0, 0, mWidth, mHeight});
+      return;
+    }
+
+    // Cells that appeared are in the new tree, cells that vanished may only be
+    // in the old one
+    mTiles.clear();
+    Diff(mRoot, mOriginX, mOriginY, mPrevious, mPreviousX, mPreviousY);
+    Diff(mPrevious, mPreviousX, mPreviousY, mRoot, mOriginX, mOriginY);
+
+    const uint32_t tile = 1 << HASHLIFE_TILE;
+    for (uint32_t t : mTiles)
+    {
+      mTileMarks[t] = 0;
+      const uint32_t x = t % mTilesX * tile, y = t / mTilesX * tile;
+      regions.push_back({x, y, std::min(mWidth, x + tile), std::min(mHeight, y + tile)});
+    }
+  }
+
+  void Set(uint32_t x, uint32_t y, bool alive)
+  {
+    while (int64_t(x) < mOriginX || int64_t(y) < mOriginY ||
+           int64_t(x) >= mOriginX + (int64_t(1) << mRoot->level) ||
+           int64_t(y) >= mOriginY + (int64_t(1) << mRoot->level))
+      Expand();
+
+    mRoot = SetCell(mRoot, x - mOriginX, y - mOriginY, alive);
+  }
+
+  // Generations advanced by every Update() as a power of two
+  uint32_t Step() const
+  {
+    return mStep;
+  }
+
+  void SetStep(uint32_t step)
+  {
+    if (step == mStep)
+      return;
+
+    // Memoised results are only valid for the step they were computed with
+    mStep = step;
+    ForEachNode([](Node& node) { node.result = nullptr; });
+  }
+
+  void SetRule(const Rule& rule) override
+  {
+    if (rule == mRule)
+      return;
+
+    // Same as for the step, results were computed under the old rule
+    mRule = rule;
+    ForEachNode([](Node& node) { node.result = nullptr; });
+  }
+
+  uint64_t Generation() const
+  {
+    return mGeneration;
+  }
+
+  size_t Nodes() const
+  {
+    return mNodes;
+  }
+
+private:
+  struct Node
+  {
+    Node* nw = nullptr;
+    Node* ne = nullptr;
+    Node* sw = nullptr;
+    Node* se = nullptr;
+
+    // Hash chain, or next free node
+    Node* next = nullptr;
+
+    // Centre of this node 2^min(step, level - 2) generations ahead
+    Node* result = nullptr;
+
+    uint64_t population = 0;
+    uint8_t level = 0;
+    bool marked = false;
+    bool used = false;
+  };
+
+  static constexpr size_t BLOCK = 1 << 14;
+
+  void Clear()
+  {
+    // Start small, the root grows on demand
+    mOriginX = 0;
+    mOriginY = 0;
+    mGeneration = 0;
+    mRoot = Empty(HASHLIFE_TILE + 2);
+    mFresh = true;
+  }
+
+  Node* Leaf(bool alive)
+  {
+    return alive ? &mAlive : &mDead;
+  }
+
+  Node* Empty(uint8_t level)
+  {
+    if (mEmpty.empty())
+      mEmpty.push_back(&mDead);
+
+    while (mEmpty.size() <= level)
+    {
+      Node* e = mEmpty.back();
+      mEmpty.push_back(Join(e, e, e, e));
+    }
+
+    return mEmpty[level];
+  }
+
+  static size_t Hash(const Node* nw, const Node* ne, const Node* sw, const Node* se)
+  {
+    uint64_t h = uintptr_t(nw);
+    h = h * 0x9E3779B97F4A7C15ull + uintptr_t(ne);
+    h = h * 0x9E3779B97F4A7C15ull + uintptr_t(sw);
+    h = h * 0x9E3779B97F4A7C15ull + uintptr_t(se);
+    return h ^ (h >> 31);
+  }
+
+  // Canonical node with the given children
+  Node* Join(Node* nw, Node* ne, Node* sw, Node* se)
+  {
+    const size_t bucket = Hash(nw, ne, sw, se) & (mBuckets.size() - 1);
+    for (Node* n = mBuckets[bucket]; n; n = n->next)
+    {
+      if (n->nw == nw && n->ne == ne && n->sw == sw && n->se == se)
+        return n;
+    }
+
+    Node* n = Allocate();
+    n->nw = nw;
+    n->ne = ne;
+    n->sw = sw;
+    n->se = se;
+    n->level = nw->level + 1;
+    n->population = nw->population + ne->population + sw->population + se->population;
+    n->next = mBuckets[bucket];
+    mBuckets[bucket] = n;
+
+    if (mNodes > mBuckets.size())
+      Rehash(mBuckets.size() * 2);
+
+    return n;
+  }
+
+  Node* Allocate()
+  {
+    if (!mFree)
+    {
+      mBlocks.emplace_back(new Node[BLOCK]);
+      Node* block = mBlocks.back().get();
+      for (size_t i = 0; i < BLOCK; ++i)
+      {
+        block[i].next = mFree;
+        mFree = &block[i];
+      }
+    }
+
+    Node* n = mFree;
+    mFree = n->next;
+    *n = Node();
+    n->used = true;
+    ++mNodes;
+    return n;
+  }
+
+  void Rehash(size_t buckets)
+  {
+    mBuckets.assign(buckets, nullptr);
+    ForEachNode([this](Node& n)
+    {
+      const size_t bucket = Hash(n.nw, n.ne, n.sw, n.se) & (mBuckets.size() - 1);
+      n.next = mBuckets[bucket];
+      mBuckets[bucket] = &n;
+    });
+  }
+
+  template <typename F>
+  void ForEachNode(F f)
+  {
+    for (auto& block : mBlocks)
+    {
+      for (size_t i = 0; i < BLOCK; ++i)
+      {
+        if (block[i].used)
+          f(block[i]);
+      }
+    }
+  }
+
+  // Drop every node that is not reachable from the root, together with all
+  // memoised results, to get back under the memory cap
+  void Collect()
+  {
+    Mark(mRoot);
+    for (Node* e : mEmpty)
+      Mark(e);
+
+    mFree = nullptr;
+    mNodes = 0;
+    for (auto& block : mBlocks)
+    {
+      for (size_t i = 0; i < BLOCK; ++i)
+      {
+        Node& n = block[i];
+        if (n.used && n.marked)
+        {
+          n.marked = false;
+          n.result = nullptr;
+          ++mNodes;
+          continue;
+        }
+
+        n.used = false;
+        n.next = mFree;
+        mFree = &n;
+      }
+    }
+
+    Rehash(mBuckets.size());
+  }
+
+  void Mark(Node* n)
+  {
+    if (n->level == 0 || n->marked)
+      return;
+
+    n->marked = true;
+    Mark(n->nw);
+    Mark(n->ne);
+    Mark(n->sw);
+    Mark(n->se);
+  }
+
+  Node* Build(uint8_t level, uint64_t x0, uint64_t y0, const std::vector<uint64_t>& rows, uint64_t stride)
+  {
+    if (x0 >= mWidth || y0 >= mHeight)
+      return Empty(level);
+
+    if (level == 0)
+      return Leaf((rows[y0 * stride + x0 / 64] >> (x0 % 64)) & 1);
+
+    const uint64_t half = uint64_t(1) << (level - 1);
+    return Join(Build(level - 1, x0, y0, rows, stride),
+                Build(level - 1, x0 + half, y0, rows, stride),
+                Build(level - 1, x0, y0 + half, rows, stride),
+                Build(level - 1, x0 + half, y0 + half, rows, stride));
+  }
+
+  Node* SetCell(Node* n, uint64_t x, uint64_t y, bool alive)
+  {
+    if (n->level == 0)
+      return Leaf(alive);
+
+    const uint64_t half = uint64_t(1) << (n->level - 1);
+    if (y < half)
+    {
+      if (x < half)
+        return Join(SetCell(n->nw, x, y, alive), n->ne, n->sw, n->se);
+      return Join(n->nw, SetCell(n->ne, x - half, y, alive), n->sw, n->se);
+    }
+
+    if (x < half)
+      return Join(n->nw, n->ne, SetCell(n->sw, x, y - half, alive), n->se);
+    return Join(n->nw, n->ne, n->sw, SetCell(n->se, x - half, y - half, alive));
+  }
+
+  // Same node one level up, centred in an empty border
+  Node* Pad(Node* n)
+  {
+    Node* e = Empty(n->level - 1);
+    return Join(Join(e, e, e, n->nw), Join(e, e, n->ne, e),
+                Join(e, n->sw, e, e), Join(n->se, e, e, e));
+  }
+
+  void Expand()
+  {
+    const int64_t quarter = int64_t(1) << (mRoot->level - 1);
+    mRoot = Pad(mRoot);
+    mOriginX -= quarter;
+    mOriginY -= quarter;
+  }
+
+  Node* Centre(Node* n)
+  {
+    return Join(n->nw->se, n->ne->sw, n->sw->ne, n->se->nw);
+  }
+
+  bool Centred(const Node* n) const
+  {
+    return n->nw->se->population + n->ne->sw->population +
+           n->sw->ne->population + n->se->nw->population == n->population;
+  }
+
+  // Shrink the root while its outer ring is empty
+  void Crop()
+  {
+    while (mRoot->level > HASHLIFE_TILE + 2 && Centred(mRoot))
+    {
+      const int64_t quarter = int64_t(1) << (mRoot->level - 2);
+      mRoot = Centre(mRoot);
+      mOriginX += quarter;
+      mOriginY += quarter;
+    }
+  }
+
+  // Live cells of n, placed at (x, y), in columns [x0, x1) and rows [y0, y1)
+  static uint64_t Count(const Node* n, int64_t x, int64_t y, int64_t x0, int64_t y0, int64_t x1, int64_t y1)
+  {
+    const int64_t size = int64_t(1) << n->level;
+    if (n->population == 0 || x >= x1 || y >= y1 || x + size <= x0 || y + size <= y0)
+      return 0;
+
+    if (x >= x0 && y >= y0 && x + size <= x1 && y + size <= y1)
+      return n->population;
+
+    const int64_t half = size / 2;
+    return Count(n->nw, x, y, x0, y0, x1, y1) + Count(n->ne, x + half, y, x0, y0, x1, y1) +
+           Count(n->sw, x, y + half, x0, y0, x1, y1) + Count(n->se, x + half, y + half, x0, y0, x1, y1);
+  }
+
+  // Live cells of n, placed at (x, y), in row `row` and columns [x0, x1) set
+  // in words, bit 0 being column x0. Only the nodes on the row are visited.
+  static void Bits(const Node* n, int64_t x, int64_t y, int64_t row, int64_t x0, int64_t x1, uint64_t* words)
+  {
+    const int64_t size = int64_t(1) << n->level;
+    if (n->population == 0 || row < y || row >= y + size || x >= x1 || x + size <= x0)
+      return;
+
+    if (n->level == 0)
+    {
+      words[(x - x0) / 64] |= uint64_t(1) << ((x - x0) % 64);
+      return;
+    }
+
+    const int64_t half = size / 2;
+    if (row < y + half)
+    {
+      Bits(n->nw, x, y, row, x0, x1, words);
+      Bits(n->ne, x + half, y, row, x0, x1, words);
+    }
+    else
+    {
+      Bits(n->sw, x, y + half, row, x0, x1, words);
+      Bits(n->se, x + half, y + half, row, x0, x1, words);
+    }
+  }
+
+  // The node of the tree `root`, placed at (ox, oy), that covers the square of
+  // 2^level cells at (x, y). A square outside of the tree gives nullptr, which
+  // stands for dead cells; false means the square is not one of its nodes.
+  static bool Find(const Node* root, int64_t ox, int64_t oy, int64_t x, int64_t y, uint8_t level, const Node*& node)
+  {
+    const int64_t size = int64_t(1) << root->level, side = int64_t(1) << level;
+    node = nullptr;
+    if (x + side <= ox || y + side <= oy || x >= ox + size || y >= oy + size)
+      return true;
+
+    if (level > root->level || x < ox || y < oy || x + side > ox + size || y + side > oy + size)
+      return false;
+
+    node = root;
+    x -= ox;
+    y -= oy;
+    while (node->level > level)
+    {
+      const int64_t half = int64_t(1) << (node->level - 1);
+      const bool east = x >= half, south = y >= half;
+      if ((!east && x + side > half) || (!south && y + side > half))
+        return false;
+
+      node = south ? (east ? node->se : node->sw) : (east ? node->ne : node->nw);
+      x -= east ? half : 0;
+      y -= south ? half : 0;
+    }
+
+    return true;
+  }
+
+  // Mark the tiles of the board where n, placed at (x, y), differs from the
+  // tree `other`
+  void Diff(const Node* n, int64_t x, int64_t y, const Node* other, int64_t ox, int64_t oy) const
+  {
+    const int64_t size = int64_t(1) << n->level;
+    if (x >= int64_t(mWidth) || y >= int64_t(mHeight) || x + size <= 0 || y + size <= 0)
+      return;
+
+    const Node* same;
+    if (Find(other, ox, oy, x, y, n->level, same) && (same == n || (!same && n->population == 0)))
+      return;
+
+    if (n->level == HASHLIFE_TILE)
+    {
+      const uint32_t tile = (y >> HASHLIFE_TILE) * mTilesX + (x >> HASHLIFE_TILE);
+      if (!mTileMarks[tile])
+      {
+        mTileMarks[tile] = 1;
+        mTiles.push_back(tile);
+      }
+      return;
+    }
+
+    const int64_t half = size / 2;
+    Diff(n->nw, x, y, other, ox, oy);
+    Diff(n->ne, x + half, y, other, ox, oy);
+    Diff(n->sw, x, y + half, other, ox, oy);
+    Diff(n->se, x + half, y + half, other, ox, oy);
+  }
+
+  // Kill every cell of n, placed at (x0, y0), that lies outside of the board
+  Node* Clip(Node* n, int64_t x0, int64_t y0)
+  {
+    const int64_t size = int64_t(1) << n->level;
+    if (n->population == 0 ||
+        (x0 >= 0 && y0 >= 0 && x0 + size <= int64_t(mWidth) && y0 + size <= int64_t(mHeight)))
+      return n;
+
+    if (x0 + size <= 0 || y0 + size <= 0 || x0 >= int64_t(mWidth) || y0 >= int64_t(mHeight))
+      return Empty(n->level);
+
+    const int64_t half = size / 2;
+    return Join(Clip(n->nw, x0, y0), Clip(n->ne, x0 + half, y0),
+                Clip(n->sw, x0, y0 + half), Clip(n->se, x0 + half, y0 + half));
+  }
+
+  // 4x4 node to its 2x2 centre one generation later
+  Node* Base(Node* n)
+  {
+    uint32_t bits = 0;
+    Node* quadrants[4] = {n->nw, n->ne, n->sw, n->se};
+    for (int q = 0; q < 4; ++q)
+    {
+      Node* cells[4] = {quadrants[q]->nw, quadrants[q]->ne, quadrants[q]->sw, quadrants[q]->se};
+      for (int c = 0; c < 4; ++c)
+      {
+        const int x = (q % 2) * 2 + c % 2;
+        const int y = (q / 2) * 2 + c / 2;
+        bits |= uint32_t(cells[c]->population) << (y * 4 + x);
+      }
+    }
+
+    Node* next[4];
+    for (int c = 0; c < 4; ++c)
+    {
+      const int x = 1 + c % 2;
+      const int y = 1 + c / 2;
+
+      int alive = 0;
+      for (int dy = -1; dy <= 1; ++dy)
+        for (int dx = -1; dx <= 1; ++dx)
+          if (dx || dy)
+            alive += (bits >> ((y + dy) * 4 + x + dx)) & 1;
+
+      const bool self = (bits >> (y * 4 + x)) & 1;
+      next[c] = Leaf(mRule.Next(self, alive));
+    }
+
+    return Join(next[0], next[1], next[2], next[3]);
+  }
+
+  // Centre of n advanced by 2^min(step, level - 2) generations
+  Node* Successor(Node* n, uint32_t step)
+  {
+    if (n->population == 0)
+      return Empty(n->level - 1);
+
+    if (n->result)
+      return n->result;
+
+    if (n->level == 2)
+      return n->result = Base(n);
+
+    const uint32_t j = std::min<uint32_t>(step, n->level - 2);
+
+    // Nine overlapping subnodes one level down
+    Node* n00 = n->nw;
+    Node* n01 = Join(n->nw->ne, n->ne->nw, n->nw->se, n->ne->sw);
+    Node* n02 = n->ne;
+    Node* n10 = Join(n->nw->sw, n->nw->se, n->sw->nw, n->sw->ne);
+    Node* n11 = Join(n->nw->se, n->ne->sw, n->sw->ne, n->se->nw);
+    Node* n12 = Join(n->ne->sw, n->ne->se, n->se->nw, n->se->ne);
+    Node* n20 = n->sw;
+    Node* n21 = Join(n->sw->ne, n->se->nw, n->sw->se, n->se->sw);
+    Node* n22 = n->se;
+
+    Node* c00 = Successor(n00, j);
+    Node* c01 = Successor(n01, j);
+    Node* c02 = Successor(n02, j);
+    Node* c10 = Successor(n10, j);
+    Node* c11 = Successor(n11, j);
+    Node* c12 = Successor(n12, j);
+    Node* c20 = Successor(n20, j);
+    Node* c21 = Successor(n21, j);
+    Node* c22 = Successor(n22, j);
+
+    if (j < uint32_t(n->level - 2))
+    {
+      // Only half of the time budget, take the centres instead of advancing again
+      return n->result = Join(Join(c00->se, c01->sw, c10->ne, c11->nw),
+                              Join(c01->se, c02->sw, c11->ne, c12->nw),
+                              Join(c10->se, c11->sw, c20->ne, c21->nw),
+                              Join(c11->se, c12->sw, c21->ne, c22->nw));
+    }
+
+    return n->result = Join(Successor(Join(c00, c01, c10, c11), j),
+                            Successor(Join(c01, c02, c11, c12), j),
+                            Successor(Join(c10, c11, c20, c21), j),
+                            Successor(Join(c11, c12, c21, c22), j));
+  }
+
+  const uint32_t mWidth;
+  const uint32_t mHeight;
+  const size_t mMaxNodes;
+
+  Node mDead;
+  Node mAlive;
+  std::vector<Node*> mEmpty;
+
+  std::vector<std::unique_ptr<Node[]>> mBlocks;
+  std::vector<Node*> mBuckets;
+  Node* mFree = nullptr;
+  size_t mNodes = 0;
+
+  Node* mRoot = nullptr;
+  int64_t mOriginX = 0;
+  int64_t mOriginY = 0;
+
+  // Root before the last Update(), fresh after a new start
+  const Node* mPrevious = nullptr;
+  int64_t mPreviousX = 0;
+  int64_t mPreviousY = 0;
+  bool mFresh = true;
+
+  // Scratch space of ChangedRegions(), a mark per tile and the marked tiles
+  const uint32_t mTilesX;
+  mutable std::vector<uint8_t> mTileMarks;
+  mutable std::vector<uint32_t> mTiles;
+
+  uint32_t mStep = 0;
+  uint64_t mGeneration = 0;
+};
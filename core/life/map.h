@@ -0,0 +1,116 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include "engine.h"
+
+// Straightforward reference implementation, one bool per cell
+class Map : public Engine
+{
+public:
+  Map(uint16_t width, uint16_t height)
+    : mWidth(width)
+    , mHeight(height)
+  {}
+
+  const char* Name() const override
+  {
+    return "map";
+  }
+
+  uint32_t Width() const override
+  {
+    return mWidth;
+  }
+
+  uint32_t Height() const override
+  {
+    return mHeight;
+  }
+
+  void Start(const std::vector<linalg::Int2d>& initial) override
+  {
+    mCells.assign(uint32_t(mWidth) * mHeight, false);
+    mSpans.assign(mHeight, Span{0, mWidth});
+
+    if (initial.empty())
+    {
+      for (size_t i = 0; i < mCells.size(); ++i)
+        mCells[i] = (rand() % 100) > ALIVE_PROB;
+
+      return;
+    }
+
+    for (const auto& p : initial)
+    {
+      if (p.X() >= 0 && p.Y() >= 0 && p.X() < mWidth && p.Y() < mHeight)
+        mCells[p.Y() * mWidth + p.X()] = true;
+    }
+  }
+
+  uint8_t Count(const std::vector<bool>& map, uint16_t x, uint16_t y)
+  {
+    uint8_t alive = 0;
+    for (int dy = -1; dy <= 1; ++dy)
+    {
+      for (int dx = -1; dx <= 1; ++dx)
+      {
+        if ((dx == 0 && dy == 0) ||
+            uint16_t(x + dx) > (mWidth - 1) ||
+            uint16_t(y + dy) > (mHeight - 1))
+          continue;
+
+        alive += uint8_t(map.at((y + dy) * mWidth + (x + dx)));
+      }
+    }
+
+    return alive;
+  }
+
+  void Update() override
+  {
+    const std::vector<bool> tmp = mCells;
+    for (int j = 0; j < mHeight; ++j)
+    {
+      Span& span = mSpans[j];
+      span = {0, 0};
+      for (int i = 0; i < mWidth; ++i)
+      {
+        auto alive = Count(tmp, i, j);
+        mCells.at(j * mWidth + i) = mRule.Next(tmp.at(j * mWidth + i), alive);
+
+        if (mCells[j * mWidth + i] != tmp[j * mWidth + i])
+        {
+          span.first = span.end == 0 ? i : span.first;
+          span.end = i + 1;
+        }
+      }
+    }
+  }
+
+  bool Alive(uint32_t x, uint32_t y) const override
+  {
+    return mCells.at(y * mWidth + x);
+  }
+
+  bool TracksChanges() const override
+  {
+    return true;
+  }
+
+  void ChangedRegions(std::vector<Region>& regions) const override
+  {
+    SpanRegions(mSpans, regions);
+  }
+
+private:
+  uint16_t mWidth;
+  uint16_t mHeight;
+
+  std::vector<bool> mCells;
+
+  // Columns of every row that changed in the last generation
+  std::vector<Span> mSpans;
+};
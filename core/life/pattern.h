@@ -0,0 +1,227 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "linalg.h"
+#include "mapped_file.h"
+
+// Live cells of a pattern file, shifted so the bounding box starts at (0, 0)
+struct Pattern
+{
+  uint32_t width = 0;
+  uint32_t height = 0;
+  std::string rule;
+  std::vector<linalg::Int2d> cells;
+
+  // Cells moved so the pattern sits in the middle of a width x height board
+  std::vector<linalg::Int2d> Centred(uint32_t boardWidth, uint32_t boardHeight) const
+  {
+    const int dx = (int(boardWidth) - int(width)) / 2;
+    const int dy = (int(boardHeight) - int(height)) / 2;
+
+    std::vector<linalg::Int2d> centred;
+    centred.reserve(cells.size());
+    for (const auto& p : cells)
+      centred.push_back({p.X() + dx, p.Y() + dy});
+
+    return centred;
+  }
+};
+
+namespace pattern
+{
+
+inline const char* NextLine(const char* it, const char* end)
+{
+  const void* newline = memchr(it, '\n', end - it);
+  return newline ? static_cast<const char*>(newline) + 1 : end;
+}
+
+inline bool StartsWith(const char* it, const char* end, const char* prefix)
+{
+  const size_t length = strlen(prefix);
+  return size_t(end - it) >= length && !strncmp(it, prefix, length);
+}
+
+// Non negative decimal at `it`, `fallback` when there are no digits
+inline uint32_t Number(const char*& it, const char* end, uint32_t fallback)
+{
+  if (it == end || !isdigit(uint8_t(*it)))
+    return fallback;
+
+  uint32_t value = 0;
+  while (it != end && isdigit(uint8_t(*it)))
+    value = value * 10 + (*it++ - '0');
+
+  return value;
+}
+
+inline void Normalise(Pattern& pattern, int minX, int minY, int maxX, int maxY)
+{
+  if (pattern.cells.empty())
+    return;
+
+  for (auto& p : pattern.cells)
+    p = {p.X() - minX, p.Y() - minY};
+
+  pattern.width = maxX - minX + 1;
+  pattern.height = maxY - minY + 1;
+}
+
+// Run length encoded: "#" comment lines, an "x = m, y = n, rule = r" header and
+// runs of b (dead), o (alive) and $ (end of row) terminated by !
+inline bool ParseRle(const char* it, const char* end, Pattern& pattern)
+{
+  bool header = false;
+  while (it != end && !header)
+  {
+    const char* line = it;
+    it = NextLine(it, end);
+
+    while (line != it && isspace(uint8_t(*line)))
+      ++line;
+
+    if (line == it || *line == '#')
+      continue;
+
+    if (*line != 'x')
+      return false;
+
+    header = true;
+
+    const std::string text(line, it);
+    const size_t rule = text.find("rule");
+    const size_t start = rule == std::string::npos ? rule : text.find('=', rule);
+    if (start != std::string::npos)
+    {
+      const size_t first = text.find_first_not_of(" \t", start + 1);
+      const size_t last = text.find_first_of(", \t\r\n", first);
+      if (first != std::string::npos)
+        pattern.rule = text.substr(first, last == std::string::npos ? last : last - first);
+    }
+  }
+
+  if (!header)
+    return false;
+
+  int x = 0, y = 0, maxX = 0, maxY = 0;
+  while (it != end)
+  {
+    if (isspace(uint8_t(*it)))
+    {
+      ++it;
+      continue;
+    }
+
+    const uint32_t count = Number(it, end, 1);
+    if (it == end)
+      return false;
+
+    const char tag = *it++;
+    if (tag == '!')
+      break;
+
+    if (tag == '$')
+    {
+      y += count;
+      x = 0;
+    }
+    else if (tag == 'b' || tag == '.')
+    {
+      x += count;
+    }
+    else if (tag == 'o' || (tag >= 'A' && tag <= 'X'))
+    {
+      // Every single letter state other than dead counts as alive, the two
+      // letter states of multistate rules are not supported
+      for (uint32_t i = 0; i < count; ++i)
+        pattern.cells.push_back({x++, y});
+      maxX = std::max(maxX, x - 1);
+      maxY = y;
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+  Normalise(pattern, 0, 0, maxX, maxY);
+  return true;
+}
+
+// Life 1.06: a "#Life 1.06" line followed by one "x y" pair per live cell
+inline bool ParseLife106(const char* it, const char* end, Pattern& pattern)
+{
+  int minX = 0, minY = 0, maxX = 0, maxY = 0;
+  while (it != end)
+  {
+    const char* line = it;
+    it = NextLine(it, end);
+
+    if (*line == '#')
+      continue;
+
+    int coordinates[2];
+    int read = 0;
+    while (read < 2)
+    {
+      while (line != it && (*line == ' ' || *line == '\t'))
+        ++line;
+
+      const bool negative = line != it && *line == '-';
+      if (negative || (line != it && *line == '+'))
+        ++line;
+
+      if (line == it || !isdigit(uint8_t(*line)))
+        break;
+
+      const int value = Number(line, it, 0);
+      coordinates[read++] = negative ? -value : value;
+    }
+
+    if (read == 0)
+      continue;
+
+    if (read != 2)
+      return false;
+
+    const int x = coordinates[0], y = coordinates[1];
+    if (pattern.cells.empty())
+    {
+      minX = maxX = x;
+      minY = maxY = y;
+    }
+
+    minX = std::min(minX, x);
+    maxX = std::max(maxX, x);
+    minY = std::min(minY, y);
+    maxY = std::max(maxY, y);
+    pattern.cells.push_back({x, y});
+  }
+
+  Normalise(pattern, minX, minY, maxX, maxY);
+  return true;
+}
+
+}
+
+// Read an RLE or Life 1.06 file, the format is picked from the first line
+inline bool LoadPattern(const char* path, Pattern& pattern)
+{
+  pattern = Pattern();
+
+  MappedFile file(path);
+  if (!file.Valid())
+    return false;
+
+  if (pattern::StartsWith(file.Begin(), file.End(), "#Life 1.06"))
+    return pattern::ParseLife106(file.Begin(), file.End(), pattern);
+
+  return pattern::ParseRle(file.Begin(), file.End(), pattern);
+}
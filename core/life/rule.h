@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cctype>
+#include <cstdint>
+#include <string>
+
+#define HIGHLIFE_BIRTH ((1 << 3) | (1 << 6))
+#define HIGHLIFE_SURVIVAL ((1 << 2) | (1 << 3))
+
+// Outer totalistic rule: bit n of birth and survival is set when a dead or live
+// cell with n live neighbours is alive in the next generation. Next() is a
+// table lookup indexed by the cell and its neighbour count, so any rule costs
+// the same as Conway's.
+class Rule
+{
+public:
+  Rule()
+    : Rule(1 << 3, (1 << 2) | (1 << 3))
+  {}
+
+  Rule(uint16_t birth, uint16_t survival)
+    : mBirth(birth & 0x1FF)
+    , mSurvival(survival & 0x1FF)
+  {
+    for (uint32_t n = 0; n < 9; ++n)
+    {
+      mTable[n] = (mBirth >> n) & 1;
+      mTable[9 + n] = (mSurvival >> n) & 1;
+    }
+  }
+
+  // "B3/S23", "S23/B3" or the older "23/3" survival/birth form, case
+  // insensitive. Rules with B0 are rejected: every engine relies on an empty
+  // region staying empty.
+  static bool Parse(const std::string& text, Rule& rule)
+  {
+    uint16_t birth = 0, survival = 0;
+    uint16_t* digits = &survival;
+    bool named = false;
+    int part = 0;
+
+    for (char c : text)
+    {
+      if (c == ' ')
+        continue;
+
+      const int lower = std::tolower(uint8_t(c));
+      if (lower == 'b' || lower == 's')
+      {
+        digits = lower == 'b' ? &birth : &survival;
+        named = true;
+      }
+      else if (c == '/')
+      {
+        if (++part > 1)
+          return false;
+
+        if (!named)
+          digits = &birth;
+      }
+      else if (c >= '0' && c <= '8')
+      {
+        *digits |= 1 << (c - '0');
+      }
+      else
+      {
+        return false;
+      }
+    }
+
+    if (part != 1 || (birth & 1))
+      return false;
+
+    rule = Rule(birth, survival);
+    return true;
+  }
+
+  bool Next(bool alive, uint32_t neighbours) const
+  {
+    return mTable[alive * 9 + neighbours];
+  }
+
+  uint16_t Birth() const
+  {
+    return mBirth;
+  }
+
+  uint16_t Survival() const
+  {
+    return mSurvival;
+  }
+
+  bool IsConway() const
+  {
+    return mBirth == (1 << 3) && mSurvival == ((1 << 2) | (1 << 3));
+  }
+
+  std::string Name() const
+  {
+    std::string name = "B";
+    for (uint32_t n = 0; n < 9; ++n)
+      if ((mBirth >> n) & 1)
+        name += char('0' + n);
+
+    name += "/S";
+    for (uint32_t n = 0; n < 9; ++n)
+      if ((mSurvival >> n) & 1)
+        name += char('0' + n);
+
+    return name;
+  }
+
+  bool operator==(const Rule& other) const
+  {
+    return mBirth == other.mBirth && mSurvival == other.mSurvival;
+  }
+
+  bool operator!=(const Rule& other) const
+  {
+    return !(*this == other);
+  }
+
+private:
+  uint16_t mBirth;
+  uint16_t mSurvival;
+
+  // Dead cells by neighbour count, then live ones
+  uint8_t mTable[18];
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#include "engine.h"
+#include "hashlife.h"
+
+#define LIFE_MIN_SECONDS 0.5
+#define LIFE_MAX_GENERATIONS 2000
+
+// Generations an engine advanced in an uncapped run
+struct LifeReport
+{
+  uint64_t generations = 0;
+  double seconds = 0;
+
+  double nsPerGeneration = 0;
+  double cellsPerSecond = 0;
+};
+
+// Update until LIFE_MIN_SECONDS have passed or LIFE_MAX_GENERATIONS were made.
+// A Hashlife update counts as the 2^step generations it advances.
+inline LifeReport MeasureLife(Engine& engine)
+{
+  using Clock = std::chrono::steady_clock;
+
+  auto hashlife = dynamic_cast<Hashlife*>(&engine);
+  const uint64_t perUpdate = hashlife ? uint64_t(1) << hashlife->Step() : 1;
+
+  LifeReport report;
+  const auto start = Clock::now();
+  while (report.seconds < LIFE_MIN_SECONDS && report.generations < LIFE_MAX_GENERATIONS)
+  {
+    engine.Update();
+    report.generations += perUpdate;
+    report.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  }
+
+  const double cells = double(engine.Width()) * engine.Height();
+  report.nsPerGeneration = report.seconds * 1e9 / report.generations;
+  report.cellsPerSecond = cells * report.generations / report.seconds;
+  return report;
+}
@@ -0,0 +1,237 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "SDL2/SDL.h"
+
+#include "density_pyramid.h"
+#include "engine.h"
+
+#define BAND_ROWS 16
+#define MAX_ZOOM_IN 4
+#define ALIVE_COLOR 0xFFFFFFFF
+#define DEAD_COLOR 0xFF000000
+#define OUTSIDE_COLOR 0xFF202020
+
+// A view of the board in a streaming texture the size of the window. At zoom
+// z >= 0 every texel is one block of 2^z x 2^z cells shaded by its population
+// from the density pyramid, at z < 0 every texel is one cell and the texture is
+// scaled up by 2^-z. Either way the texels fill the window once, so a frame
+// costs the same however large the board is.
+//
+// While the view stays put only bands of BAND_ROWS texel rows that show a
+// region the engine reports as changed are uploaded, and the whole view is
+// drawn with one copy.
+class BoardTexture
+{
+public:
+  BoardTexture(SDL_Renderer* renderer, const Engine& engine, int viewWidth, int viewHeight)
+    : mEngine(engine)
+    , mPyramid(engine)
+    , mViewWidth(viewWidth)
+    , mViewHeight(viewHeight)
+    , mTexture(SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, viewWidth + 1, viewHeight + 1))
+  {
+    Fit();
+  }
+
+  ~BoardTexture()
+  {
+    SDL_DestroyTexture(mTexture);
+  }
+
+  BoardTexture(const BoardTexture&) = delete;
+  BoardTexture& operator=(const BoardTexture&) = delete;
+
+  // Largest zoom that shows the whole board, centred
+  void Fit()
+  {
+    mZoom = -MAX_ZOOM_IN;
+    while (mZoom < int(mPyramid.Top()) &&
+           (Cells(mViewWidth) < mEngine.Width() || Cells(mViewHeight) < mEngine.Height()))
+      ++mZoom;
+
+    mX = (double(mEngine.Width()) - Cells(mViewWidth)) / 2;
+    mY = (double(mEngine.Height()) - Cells(mViewHeight)) / 2;
+    mMoved = true;
+  }
+
+  // Move the view by a number of window pixels
+  void Pan(int dx, int dy)
+  {
+    mX += Cells(dx);
+    mY += Cells(dy);
+    mMoved = true;
+  }
+
+  // Zoom in (steps > 0) or out by powers of two, keeping the cell under the
+  // window pixel (px, py) in place
+  void Zoom(int steps, int px, int py)
+  {
+    const int zoom = std::max(-MAX_ZOOM_IN, std::min(int(mPyramid.Top()), mZoom - steps));
+    if (zoom == mZoom)
+      return;
+
+    const double cx = mX + Cells(px), cy = mY + Cells(py);
+    mZoom = zoom;
+    mX = cx - Cells(px);
+    mY = cy - Cells(py);
+    mMoved = true;
+  }
+
+  // Bring the texture up to date with the last generation, or with a new
+  // board when `restart` is set
+  void Update(bool restart = false)
+  {
+    mPyramid.Update(restart || mFirst);
+
+    // Texels of the view, the top left one may be partly outside the window
+    const uint32_t level = std::max(mZoom, 0);
+    const double texel = std::ldexp(1.0, int(level));
+    mTexelX = int64_t(std::floor(mX / texel));
+    mTexelY = int64_t(std::floor(mY / texel));
+    mTexelsX = std::min<int64_t>(mViewWidth + 1, int64_t(std::ceil(Cells(mViewWidth) / texel)) + 1);
+    mTexelsY = std::min<int64_t>(mViewHeight + 1, int64_t(std::ceil(Cells(mViewHeight) / texel)) + 1);
+
+    const bool all = restart || mFirst || mMoved;
+    mUploadedRows = 0;
+    if (!all)
+      MarkBands(level);
+
+    // Locked texels are write only, so every run of dirty bands is locked and
+    // rewritten as a whole
+    uint32_t y0 = 0;
+    while (y0 < mTexelsY)
+    {
+      if (!all && !mBands[y0 / BAND_ROWS])
+      {
+        y0 += BAND_ROWS;
+        continue;
+      }
+
+      uint32_t y1 = std::min<uint32_t>(mTexelsY, y0 + BAND_ROWS);
+      while (y1 < mTexelsY && (all || mBands[y1 / BAND_ROWS]))
+        y1 = std::min<uint32_t>(mTexelsY, y1 + BAND_ROWS);
+
+      Upload(level, y0, y1);
+      y0 = y1;
+    }
+
+    mFirst = false;
+    mMoved = false;
+  }
+
+  void Draw(SDL_Renderer* renderer)
+  {
+    // Pixels per texel and where the first texel starts in the window
+    const double scale = std::ldexp(1.0, -std::min(mZoom, 0));
+    const double texel = std::ldexp(1.0, std::max(mZoom, 0));
+    const int offsetX = int(std::floor((mTexelX * texel - mX) / texel * scale));
+    const int offsetY = int(std::floor((mTexelY * texel - mY) / texel * scale));
+
+    const SDL_Rect source{0, 0, int(mTexelsX), int(mTexelsY)};
+    const SDL_Rect dest{offsetX, offsetY, int(mTexelsX * scale), int(mTexelsY * scale)};
+    SDL_RenderCopy(renderer, mTexture, &source, &dest);
+  }
+
+  int Zoom() const
+  {
+    return mZoom;
+  }
+
+  // Texel rows sent to the texture by the last Update()
+  uint32_t UploadedRows() const
+  {
+    return mUploadedRows;
+  }
+
+private:
+  // Cells covered by a number of window pixels at the current zoom
+  double Cells(int pixels) const
+  {
+    return std::ldexp(double(pixels), mZoom);
+  }
+
+  // Flag the bands whose texels show any region that changed
+  void MarkBands(uint32_t level)
+  {
+    mBands.assign((mTexelsY + BAND_ROWS - 1) / BAND_ROWS, 0);
+    for (const Region& region : mPyramid.Changes())
+    {
+      if (region.x0 >= region.x1 || region.y0 >= region.y1)
+        continue;
+
+      const int64_t left = (int64_t(region.x0) >> level) - mTexelX;
+      const int64_t right = (int64_t(region.x1 - 1) >> level) - mTexelX;
+      const int64_t top = (int64_t(region.y0) >> level) - mTexelY;
+      const int64_t bottom = (int64_t(region.y1 - 1) >> level) - mTexelY;
+      if (right < 0 || left >= mTexelsX || bottom < 0 || top >= mTexelsY)
+        continue;
+
+      for (int64_t band = std::max<int64_t>(0, top) / BAND_ROWS; band <= std::min<int64_t>(mTexelsY - 1, bottom) / BAND_ROWS; ++band)
+        mBands[band] = 1;
+    }
+  }
+
+  void Upload(uint32_t level, uint32_t y0, uint32_t y1)
+  {
+    const SDL_Rect rows{0, int(y0), int(mTexelsX), int(y1 - y0)};
+
+    void* pixels;
+    int pitch;
+    if (SDL_LockTexture(mTexture, &rows, &pixels, &pitch) != 0)
+      return;
+
+    const double area = std::ldexp(1.0, 2 * level);
+    for (uint32_t y = y0; y < y1; ++y)
+    {
+      uint32_t* texels = reinterpret_cast<uint32_t*>(static_cast<uint8_t*>(pixels) + (y - y0) * pitch);
+      const int64_t by = mTexelY + y;
+      for (uint32_t x = 0; x < mTexelsX; ++x)
+      {
+        const int64_t bx = mTexelX + x;
+        if (bx < 0 || by < 0 || (bx << level) >= int64_t(mEngine.Width()) || (by << level) >= int64_t(mEngine.Height()))
+        {
+          texels[x] = OUTSIDE_COLOR;
+          continue;
+        }
+
+        // Any live cell shows, denser blocks are brighter
+        const uint64_t count = mPyramid.Count(level, bx, by);
+        const uint32_t grey = count ? 64 + uint32_t(191 * std::min(1.0, count / area)) : 0;
+        texels[x] = level == 0 ? (count ? ALIVE_COLOR : DEAD_COLOR) : (DEAD_COLOR | grey << 16 | grey << 8 | grey);
+      }
+    }
+
+    SDL_UnlockTexture(mTexture);
+    mUploadedRows += y1 - y0;
+  }
+
+  const Engine& mEngine;
+  DensityPyramid mPyramid;
+
+  const int mViewWidth;
+  const int mViewHeight;
+  SDL_Texture* mTexture;
+
+  // Board position of the window's top left corner in cells, and log2 of
+  // cells per pixel
+  double mX = 0;
+  double mY = 0;
+  int mZoom = 0;
+
+  int64_t mTexelX = 0;
+  int64_t mTexelY = 0;
+  uint32_t mTexelsX = 0;
+  uint32_t mTexelsY = 0;
+
+  bool mFirst = true;
+  bool mMoved = true;
+  uint32_t mUploadedRows = 0;
+
+  // Bands of BAND_ROWS texel rows to upload
+  std::vector<uint8_t> mBands;
+};
@@ -1,7 +1,13 @@
 #include "logging.h"
 #include "linalg.h"
+#include "board_texture.h"
+#include "cycle_detector.h"
+#include "engines.h"
+#include "pattern.h"
 
 #include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <memory>
 #include <random>
 
@@ -12,7 +18,8 @@
 #define HEIGHT 1000
 #define TILE_SIZE 10
 #define FPS 15
-#define ALIVE_PROB 50
+#define PAN_STEP 64
+#define ENGINE "bitmap"
 
 TTF_Font* font;
 
@@ -54,95 +61,96 @@ void PrintText(SDL_Renderer* renderer, SDL_Rect dest, const std::string& text)
   SDL_FreeSurface(text_surf);
 }
 
-class Map
+int main(int argc, char* argv[])
 {
-public:
-  Map(uint16_t width, uint16_t height)
-    : mWidth(width)
-    , mHeight(height)
-  {}
-
-  void Start(const std::vector<linalg::Int2d>& initial)
+  const char* engineName = ENGINE;
+  uint32_t step = 0;
+  unsigned threads = 1;
+  uint32_t size = WIDTH / TILE_SIZE;
+  const char* patternFile = nullptr;
+  const char* ruleText = nullptr;
+  for (int i = 1; i < argc; ++i)
   {
-    for (uint16_t j = 0; j < mHeight; ++j)
+    if (!strcmp(argv[i], "--engine") && i + 1 < argc)
     {
-      for (uint16_t i = 0; i < mWidth; ++i)
-      {
-        if (initial.empty())
-          mCells.push_back((rand() % 100) > ALIVE_PROB);
-        else
-          mCells.push_back(std::find_if(initial.begin(), initial.end(), [i, j](const linalg::Int2d& p){ return p == linalg::Int2d(i, j); }) != initial.end());
-      }
+      engineName = argv[++i];
     }
-  }
-
-  uint8_t Count(const std::vector<bool>& map, uint16_t x, uint16_t y)
-  {
-    uint8_t alive = 0;
-    for (int dy = -1; dy <= 1; ++dy)
+    else if (!strcmp(argv[i], "--step") && i + 1 < argc)
     {
-      for (int dx = -1; dx <= 1; ++dx)
-      {
-        if ((dx == 0 && dy == 0) ||
-            uint16_t(x + dx) > (mWidth - 1) ||
-            uint16_t(y + dy) > (mHeight - 1))
-          continue;
-
-        alive += uint8_t(map.at((y + dy) * mWidth + (x + dx)));
-      }
+      step = strtoul(argv[++i], nullptr, 10);
+    }
+    else if (!strcmp(argv[i], "--threads") && i + 1 < argc)
+    {
+      threads = strtoul(argv[++i], nullptr, 10);
+    }
+    else if (!strcmp(argv[i], "--pattern") && i + 1 < argc)
+    {
+      patternFile = argv[++i];
+    }
+    else if (!strcmp(argv[i], "--size") && i + 1 < argc)
+    {
+      size = strtoul(argv[++i], nullptr, 10);
+    }
+    else if (!strcmp(argv[i], "--rule") && i + 1 < argc)
+    {
+      ruleText = argv[++i];
+    }
+    else
+    {
+      printf("Usage: %s [--engine %s] [--step log2 generations per frame, hashlife only] [--threads n, 0 for all cores] [--pattern file.rle|file.lif] [--rule B3/S23] [--size cells per side]\n", argv[0], ENGINES);
+      return -1;
     }
-
-    return alive;
   }
 
-  void Update()
+  if (size < 1 || size > MaxEngineSize(engineName))
   {
-    const std::vector<bool> tmp = mCells;
-    for (int j = 0; j < mHeight; ++j)
-    {
-      for (int i = 0; i < mWidth; ++i)
-      {
-        auto alive = Count(tmp, i, j);
+    printf("Usage: --size takes 1 to %u cells per side for %s\n", MaxEngineSize(engineName), engineName);
+    return -1;
+  }
 
-        if (mCells.at(j * mWidth + i))
-        {
-          if (alive == 2 || alive == 3)
-            mCells.at(j * mWidth + i) = true;
-          else
-            mCells.at(j * mWidth + i) = false;
-        }
-        else
-        {
-          if (alive == 3)
-            mCells.at(j * mWidth + i) = true;
-        }
-      }
-    }
+  auto map = MakeEngine(engineName, size, size, threads);
+  if (!map)
+  {
+    LOG_ERROR("Unknown engine");
+    return -1;
   }
 
-  void Draw(SDL_Renderer* renderer)
+  Pattern pattern;
+  if (patternFile && !LoadPattern(patternFile, pattern))
   {
-    for (int j = 0; j < mHeight; ++j)
-    {
-      for (int i = 0; i < mWidth; ++i)
-      {
-        SDL_Rect rect{i * TILE_SIZE, j * TILE_SIZE, TILE_SIZE, TILE_SIZE};
+    LOG_ERROR("Failed to load pattern");
+    return -1;
+  }
 
-        if (mCells.at(j * mWidth + i))
-          SDL_RenderDrawRect(renderer, &rect);
-      }
-    }
+  // An explicit rule wins over the one stored in the pattern
+  Rule rule;
+  if (!ruleText && !pattern.rule.empty())
+    ruleText = pattern.rule.c_str();
+
+  if (ruleText && !Rule::Parse(ruleText, rule))
+  {
+    LOG_ERROR("Unsupported rule");
+    return -1;
   }
 
-private:
-  uint16_t mWidth;
-  uint16_t mHeight;
+  map->SetRule(rule);
 
-  std::vector<bool> mCells;
-};
+  auto hashlife = dynamic_cast<Hashlife*>(map.get());
+  if (hashlife)
+    hashlife->SetStep(step);
+
+  // Settled boards are replayed instead of simulated, when the engine reports
+  // its changes and watching costs nothing while the board settles. Hashlife
+  // steps of more than one generation are left alone, the detector counts
+  // periods in updates.
+  const BitMap* bitmap = dynamic_cast<const BitMap*>(map.get());
+  CycleDetector* cycles = nullptr;
+  if (map->TracksChanges() && !(hashlife && step > 0))
+  {
+    cycles = new CycleDetector(std::move(map));
+    map.reset(cycles);
+  }
 
-int main()
-{
   srand(time(NULL));
 
   SDL_Init(SDL_INIT_VIDEO);
@@ -169,9 +177,9 @@ int main()
                                         SDL_WINDOW_SHOWN);
 
   SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+  BoardTexture board(renderer, *map, WIDTH, HEIGHT);
 
-  Map map(WIDTH / TILE_SIZE, HEIGHT / TILE_SIZE);
-  map.Start({});
+  map->Start(pattern.Centred(map->Width(), map->Height()));
 
   while (run)
   {
@@ -183,15 +191,61 @@ int main()
         run = false;
         break;
       }
+
+      // Wheel zooms around the mouse, dragging or the arrows pan and f shows the whole board
+      if (event.type == SDL_MOUSEWHEEL)
+      {
+        int x, y;
+        SDL_GetMouseState(&x, &y);
+        board.Zoom(event.wheel.y, x, y);
+      }
+      else if (event.type == SDL_MOUSEMOTION && (event.motion.state & SDL_BUTTON_LMASK))
+      {
+        board.Pan(-event.motion.xrel, -event.motion.yrel);
+      }
+      else if (event.type == SDL_KEYDOWN)
+      {
+        switch (event.key.keysym.sym)
+        {
+          case SDLK_LEFT:
+            board.Pan(-PAN_STEP, 0);
+            break;
+          case SDLK_RIGHT:
+            board.Pan(PAN_STEP, 0);
+            break;
+          case SDLK_UP:
+            board.Pan(0, -PAN_STEP);
+            break;
+          case SDLK_DOWN:
+            board.Pan(0, PAN_STEP);
+            break;
+          case SDLK_f:
+            board.Fit();
+            break;
+        }
+      }
     }
 
+    map->Update();
+    board.Update();
+
     SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
     SDL_RenderClear(renderer);
+    board.Draw(renderer);
 
-    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 200);
-
-    map.Update();
-    map.Draw(renderer);
+    char title[128];
+    if (cycles && cycles->Period())
+    {
+      snprintf(title, sizeof(title), "Game of life - period %u cycle since generation %lu",
+               cycles->Period(), (unsigned long)cycles->DetectedAt());
+      SDL_SetWindowTitle(window, title);
+    }
+    else if (bitmap)
+    {
+      snprintf(title, sizeof(title), "Game of life - %lu / %lu tiles active",
+               (unsigned long)bitmap->ActiveTiles(), (unsigned long)bitmap->TotalTiles());
+      SDL_SetWindowTitle(window, title);
+    }
 
     SDL_RenderPresent(renderer);
     SDL_Delay(1000 / FPS);
@@ -0,0 +1,272 @@
+#include "cycle_detector.h"
+#include "engines.h"
+#include "pattern.h"
+#include "throughput.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#define SEED 42
+#define MAP_MAX_SIZE 1024
+#define HASHLIFE_STEP 6
+#define VERIFY_WIDTH 210
+#define VERIFY_HEIGHT 150
+#define VERIFY_GENERATIONS 300
+#define VERIFY_CYCLE_GENERATIONS 6000
+
+static const char* GOSPER_GUN =
+  "x = 36, y = 9\n"
+  "24bo$22bobo$12b2o6b2o12b2o$11bo3bo4b2o12b2o$2o8bo5bo3b2o$2o8bo3bob2o4b\n"
+  "obo$10bo5bo7bo$11bo3bo$12b2o!";
+
+// Seeded starting boards, an empty list of cells means a random board
+enum class Board
+{
+  Random,
+  Guns,
+  RPentomino
+};
+
+const char* BoardName(Board board)
+{
+  switch (board)
+  {
+    case Board::Random:
+      return "random";
+    case Board::Guns:
+      return "guns";
+    default:
+      return "r-pentomino";
+  }
+}
+
+std::vector<linalg::Int2d> Cells(Board board, uint32_t width, uint32_t height)
+{
+  std::vector<linalg::Int2d> cells;
+
+  if (board == Board::Guns)
+  {
+    Pattern gun;
+    pattern::ParseRle(GOSPER_GUN, GOSPER_GUN + strlen(GOSPER_GUN), gun);
+
+    // A grid of guns with room for their gliders to fly before they collide
+    for (uint32_t y = 0; y + gun.height < height; y += 4 * gun.height)
+      for (uint32_t x = 0; x + gun.width < width; x += 2 * gun.width)
+        for (const auto& p : gun.cells)
+          cells.push_back({int(x) + p.X(), int(y) + p.Y()});
+  }
+  else if (board == Board::RPentomino)
+  {
+    const int x = width / 2, y = height / 2;
+    cells = {{x, y - 1}, {x + 1, y - 1}, {x - 1, y}, {x, y}, {x, y + 1}};
+  }
+
+  return cells;
+}
+
+void Seed(Engine& engine, Board board)
+{
+  srand(SEED);
+  engine.Start(Cells(board, engine.Width(), engine.Height()));
+}
+
+// FNV-1a over the board in row major order
+uint64_t Hash(const Engine& engine)
+{
+  uint64_t hash = 14695981039346656037ull;
+  for (uint32_t y = 0; y < engine.Height(); ++y)
+  {
+    for (uint32_t x = 0; x < engine.Width(); ++x)
+    {
+      hash ^= engine.Alive(x, y);
+      hash *= 1099511628211ull;
+    }
+  }
+
+  return hash;
+}
+
+// Run every engine next to Map and compare the board after each generation,
+// returns false on the first difference
+bool Verify(const Rule& rule, unsigned threads)
+{
+  bool ok = true;
+  for (Board board : {Board::Random, Board::Guns, Board::RPentomino})
+  {
+    for (const char* name : ENGINE_NAMES)
+    {
+      if (!strcmp(name, "map"))
+        continue;
+
+      Map reference(VERIFY_WIDTH, VERIFY_HEIGHT);
+      auto engine = MakeEngine(name, VERIFY_WIDTH, VERIFY_HEIGHT, threads);
+      reference.SetRule(rule);
+      engine->SetRule(rule);
+      Seed(reference, board);
+      Seed(*engine, board);
+
+      uint32_t generation = 0;
+      while (generation < VERIFY_GENERATIONS && Hash(reference) == Hash(*engine))
+      {
+        reference.Update();
+        engine->Update();
+        ++generation;
+      }
+
+      const bool same = Hash(reference) == Hash(*engine);
+      printf("  %-8s %-12s %-10s %s", rule.Name().c_str(), BoardName(board), name, same ? "ok\n" : "MISMATCH");
+      if (!same)
+        printf(" at generation %u\n", generation);
+
+      ok = ok && same;
+    }
+  }
+
+  return ok;
+}
+
+// Cells of the board in row major order
+std::vector<uint8_t> Snapshot(const Engine& engine)
+{
+  std::vector<uint8_t> cells(size_t(engine.Width()) * engine.Height());
+  for (uint32_t y = 0; y < engine.Height(); ++y)
+    for (uint32_t x = 0; x < engine.Width(); ++x)
+      cells[size_t(y) * engine.Width() + x] = engine.Alive(x, y);
+
+  return cells;
+}
+
+// Whether an engine answers every query like the reference board `cells`, and
+// its ChangedRegions() cover every cell that differs from `before`
+bool Matches(const Engine& engine, const Map& reference, const std::vector<uint8_t>& cells, const std::vector<uint8_t>& before)
+{
+  const uint32_t width = engine.Width(), height = engine.Height();
+  if (Snapshot(engine) != cells || engine.Population() != reference.Population() ||
+      engine.CountAlive(width / 3, height / 3, width, height) != reference.CountAlive(width / 3, height / 3, width, height))
+    return false;
+
+  std::vector<uint64_t> words((width + 63) / 64);
+  for (uint32_t y = 0; y < height; ++y)
+  {
+    engine.Row(y, 0, width, words.data());
+    for (uint32_t x = 0; x < width; ++x)
+      if (((words[x / 64] >> (x % 64)) & 1) != cells[size_t(y) * width + x])
+        return false;
+  }
+
+  std::vector<Region> regions;
+  engine.ChangedRegions(regions);
+  std::vector<uint8_t> covered(cells.size(), 0);
+  for (const Region& region : regions)
+    for (uint32_t y = region.y0; y < region.y1; ++y)
+      for (uint32_t x = region.x0; x < region.x1; ++x)
+        covered[size_t(y) * width + x] = 1;
+
+  for (size_t i = 0; i < cells.size(); ++i)
+    if (cells[i] != before[i] && !covered[i])
+      return false;
+
+  return true;
+}
+
+// Run engines wrapped in the cycle detector next to Map until long after a
+// random board settled, so the replay of stored states is compared as well
+bool VerifyCycles(unsigned threads)
+{
+  bool ok = true;
+  for (const char* name : {"bitmap", "hashlife"})
+  {
+    Map reference(VERIFY_WIDTH, VERIFY_HEIGHT);
+    CycleDetector cycles(MakeEngine(name, VERIFY_WIDTH, VERIFY_HEIGHT, threads));
+    Seed(reference, Board::Random);
+    Seed(cycles, Board::Random);
+
+    std::vector<uint8_t> before = Snapshot(reference);
+    uint32_t generation = 0;
+    bool same = true;
+    while (same && generation < VERIFY_CYCLE_GENERATIONS)
+    {
+      reference.Update();
+      cycles.Update();
+      ++generation;
+
+      const std::vector<uint8_t> cells = Snapshot(reference);
+      same = Matches(cycles, reference, cells, before);
+      before = cells;
+    }
+
+    // Only a board that settled has been replayed
+    same = same && cycles.Period();
+    printf("  %-12s %-10s %s", "cycles", name, same ? "ok" : "MISMATCH");
+    if (same)
+      printf(", period %u from generation %lu\n", cycles.Period(), (unsigned long)cycles.DetectedAt());
+    else
+      printf(" at generation %u\n", generation);
+
+    ok = ok && same;
+  }
+
+  return ok;
+}
+
+// Print the throughput of an uncapped run
+void Measure(Engine& engine, Board board, const char* label)
+{
+  const LifeReport report = MeasureLife(engine);
+  printf("%-12s %6u %-14s %8lu %14.1f %14.3e %10lu\n", BoardName(board), engine.Width(), label,
+         (unsigned long)report.generations, report.nsPerGeneration, report.cellsPerSecond,
+         (unsigned long)engine.Population());
+}
+
+// Differential check of every engine against Map, then throughput of each
+// engine on seeded boards of several sizes
+int main(int argc, char* argv[])
+{
+  const unsigned threads = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1;
+
+  printf("Verifying against map, %u generations on %ux%u\n", VERIFY_GENERATIONS, VERIFY_WIDTH, VERIFY_HEIGHT);
+  Rule highlife(HIGHLIFE_BIRTH, HIGHLIFE_SURVIVAL);
+  if (!Verify(Rule(), threads) || !Verify(highlife, threads))
+    return -1;
+
+  printf("\nVerifying the cycle detector against map, up to %u generations on %ux%u\n", VERIFY_CYCLE_GENERATIONS,
+         VERIFY_WIDTH, VERIFY_HEIGHT);
+  if (!VerifyCycles(threads))
+    return -1;
+
+  printf("\n%-12s %6s %-14s %8s %14s %14s %10s\n", "board", "size", "engine", "gens", "ns/gen", "cells/s", "population");
+
+  for (uint32_t size : {256u, 1024u, 4096u})
+  {
+    for (Board board : {Board::Random, Board::Guns, Board::RPentomino})
+    {
+      for (const char* name : ENGINE_NAMES)
+      {
+        // The reference engine is far too slow for the large boards
+        if (!strcmp(name, "map") && size > MAP_MAX_SIZE)
+          continue;
+
+        auto engine = MakeEngine(name, size, size, threads);
+        Seed(*engine, board);
+        Measure(*engine, board, name);
+
+        // Hashlife is meant to skip ahead, also show it with larger steps
+        // where the board is not pure noise
+        if (auto hashlife = dynamic_cast<Hashlife*>(engine.get()))
+        {
+          if (board == Board::Random)
+            continue;
+
+          const std::string label = std::string(name) + " 2^" + std::to_string(HASHLIFE_STEP);
+          hashlife->SetStep(HASHLIFE_STEP);
+          Seed(*hashlife, board);
+          Measure(*hashlife, board, label.c_str());
+        }
+      }
+    }
+  }
+
+  return 0;
+}
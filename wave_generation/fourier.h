@@ -0,0 +1,204 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#define FFT_MAX_RADIX 7
+
+using Complex = std::complex<double>;
+
+namespace fourier
+{
+
+// e^(-2 pi i j / n) for j in [0, count)
+inline std::vector<Complex> Roots(size_t n, size_t count)
+{
+  std::vector<Complex> roots(count);
+  for (size_t j = 0; j < count; ++j)
+    roots[j] = std::polar(1.0, -2 * M_PI * double(j) / double(n));
+
+  return roots;
+}
+
+inline size_t LargestFactor(size_t n)
+{
+  size_t largest = 1;
+  for (size_t p = 2; p * p <= n; ++p)
+  {
+    while (n % p == 0)
+    {
+      largest = p;
+      n /= p;
+    }
+  }
+
+  return std::max(largest, n);
+}
+
+// Iterative in place transform for power of two sizes
+inline void Radix2(std::vector<Complex>& data)
+{
+  const size_t n = data.size();
+  for (size_t i = 1, j = 0; i < n; ++i)
+  {
+    size_t bit = n >> 1;
+    for (; j & bit; bit >>= 1)
+      j ^= bit;
+    j ^= bit;
+
+    if (i < j)
+      std::swap(data[i], data[j]);
+  }
+
+  const std::vector<Complex> roots = Roots(n, n / 2);
+  for (size_t length = 2; length <= n; length <<= 1)
+  {
+    const size_t step = n / length;
+    for (size_t i = 0; i < n; i += length)
+    {
+      for (size_t k = 0; k < length / 2; ++k)
+      {
+        const Complex even = data[i + k];
+        const Complex odd = data[i + k + length / 2] * roots[k * step];
+        data[i + k] = even + odd;
+        data[i + k + length / 2] = even - odd;
+      }
+    }
+  }
+}
+
+// Transform of the n inputs at `in` spaced by `stride` into `out`, split by
+// the smallest factor p of n into p transforms of n / p that are combined with
+// p point butterflies. `roots` holds the roots of the full size N and
+// rootStride is N / n.
+inline void MixedRadix(const Complex* in, size_t stride, Complex* out, size_t n,
+                       const std::vector<Complex>& roots, size_t rootStride, std::vector<Complex>& scratch)
+{
+  if (n == 1)
+  {
+    out[0] = in[0];
+    return;
+  }
+
+  size_t p = 2;
+  while (n % p)
+    ++p;
+  const size_t m = n / p;
+
+  for (size_t r = 0; r < p; ++r)
+    MixedRadix(in + r * stride, stride * p, out + r * m, m, roots, rootStride * p, scratch);
+
+  const size_t size = roots.size();
+  Complex* twiddled = &scratch[0];
+  for (size_t k = 0; k < m; ++k)
+  {
+    for (size_t r = 0; r < p; ++r)
+      twiddled[r] = out[r * m + k] * roots[(r * k * rootStride) % size];
+
+    for (size_t q = 0; q < p; ++q)
+    {
+      Complex sum = 0;
+      for (size_t r = 0; r < p; ++r)
+        sum += twiddled[r] * roots[(r * q * m * rootStride) % size];
+
+      out[q * m + k] = sum;
+    }
+  }
+}
+
+// Any size as a convolution with a chirp, which is done with power of two
+// transforms of at least twice the size
+inline void Bluestein(std::vector<Complex>& data)
+{
+  const size_t n = data.size();
+  size_t size = 1;
+  while (size < 2 * n - 1)
+    size <<= 1;
+
+  // k^2 taken modulo 2n keeps the angles exact for large k
+  std::vector<Complex> chirp(n);
+  for (size_t k = 0; k < n; ++k)
+    chirp[k] = std::polar(1.0, -M_PI * double((uint64_t(k) * k) % (2 * n)) / double(n));
+
+  std::vector<Complex> a(size, 0), b(size, 0);
+  for (size_t k = 0; k < n; ++k)
+    a[k] = data[k] * chirp[k];
+
+  b[0] = std::conj(chirp[0]);
+  for (size_t k = 1; k < n; ++k)
+    b[k] = b[size - k] = std::conj(chirp[k]);
+
+  Radix2(a);
+  Radix2(b);
+
+  // Inverse through the forward transform of the conjugate
+  for (size_t k = 0; k < size; ++k)
+    a[k] = std::conj(a[k] * b[k]);
+  Radix2(a);
+
+  for (size_t k = 0; k < n; ++k)
+    data[k] = std::conj(a[k]) / double(size) * chirp[k];
+}
+
+} // namespace fourier
+
+// In place discrete Fourier transform, X_k = sum of x_n e^(-2 pi i k n / N).
+// Powers of two use the radix 2 transform, sizes made of factors up to
+// FFT_MAX_RADIX the mixed radix one and anything else Bluestein's algorithm,
+// so every size takes O(N log N).
+inline void FFT(std::vector<Complex>& data)
+{
+  const size_t n = data.size();
+  if (n <= 1)
+    return;
+
+  if ((n & (n - 1)) == 0)
+  {
+    fourier::Radix2(data);
+  }
+  else if (fourier::LargestFactor(n) <= FFT_MAX_RADIX)
+  {
+    const std::vector<Complex> input = data;
+    std::vector<Complex> scratch(FFT_MAX_RADIX);
+    fourier::MixedRadix(input.data(), 1, data.data(), n, fourier::Roots(n, n), 1, scratch);
+  }
+  else
+  {
+    fourier::Bluestein(data);
+  }
+}
+
+// One term c e^(2 pi i k t / N) of the Fourier series of a closed path
+struct Epicycle
+{
+  double amplitude;
+  double phase;
+  int64_t frequency;
+};
+
+// The `count` largest terms of the series through the given points, largest
+// first. The constant term is left out, the path is drawn around its centre.
+inline std::vector<Epicycle> Epicycles(std::vector<Complex> path, size_t count)
+{
+  const size_t n = path.size();
+  FFT(path);
+
+  std::vector<Epicycle> epicycles;
+  epicycles.reserve(n);
+  for (size_t k = 1; k < n; ++k)
+  {
+    const Complex c = path[k] / double(n);
+    epicycles.push_back({std::abs(c), std::arg(c), k <= n / 2 ? int64_t(k) : int64_t(k) - int64_t(n)});
+  }
+
+  count = std::min(count, epicycles.size());
+  std::partial_sort(epicycles.begin(), epicycles.begin() + count, epicycles.end(),
+                    [](const Epicycle& a, const Epicycle& b) { return a.amplitude > b.amplitude; });
+  epicycles.resize(count);
+
+  return epicycles;
+}
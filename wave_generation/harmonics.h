@@ -0,0 +1,224 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "cpu_dispatch.h"
+
+#define HARMONICS_RENORMALISE 1024
+
+// Arrays of a set of harmonics as seen by the kernels. Each harmonic is a
+// phasor re + i im turned every frame by its rotor, the complex number of unit
+// length at minus its frequency.
+struct HarmonicsView
+{
+  double* re;
+  double* im;
+  const double* rotorRe;
+  const double* rotorIm;
+
+  // Running sums of the phasors, the tip of every link of the epicycle chain
+  double* sumX;
+  double* sumY;
+};
+
+// Rotate harmonics [begin, end) one frame and extend the running sums over them
+using HarmonicsKernel = void (*)(const HarmonicsView&, size_t, size_t);
+
+inline void AdvanceScalar(const HarmonicsView& v, size_t begin, size_t end)
+{
+  double x = begin ? v.sumX[begin - 1] : 0;
+  double y = begin ? v.sumY[begin - 1] : 0;
+  for (size_t i = begin; i < end; ++i)
+  {
+    const double re = v.re[i] * v.rotorRe[i] - v.im[i] * v.rotorIm[i];
+    const double im = v.re[i] * v.rotorIm[i] + v.im[i] * v.rotorRe[i];
+    v.re[i] = re;
+    v.im[i] = im;
+
+    x += re;
+    y += im;
+    v.sumX[i] = x;
+    v.sumY[i] = y;
+  }
+}
+
+#if defined(__x86_64__)
+// Inclusive prefix sum of the four lanes, in two shifted additions
+__attribute__((target("avx2")))
+inline __m256d Scan(__m256d v)
+{
+  const __m256d zero = _mm256_setzero_pd();
+  v = _mm256_add_pd(v, _mm256_blend_pd(_mm256_permute4x64_pd(v, _MM_SHUFFLE(2, 1, 0, 0)), zero, 0x1));
+  v = _mm256_add_pd(v, _mm256_blend_pd(_mm256_permute4x64_pd(v, _MM_SHUFFLE(1, 0, 0, 0)), zero, 0x3));
+  return v;
+}
+
+__attribute__((target("avx2")))
+inline void AdvanceAvx2(const HarmonicsView& v, size_t begin, size_t end)
+{
+  __m256d x = _mm256_set1_pd(begin ? v.sumX[begin - 1] : 0);
+  __m256d y = _mm256_set1_pd(begin ? v.sumY[begin - 1] : 0);
+
+  size_t i = begin;
+  for (; i + 4 <= end; i += 4)
+  {
+    const __m256d re = _mm256_loadu_pd(v.re + i);
+    const __m256d im = _mm256_loadu_pd(v.im + i);
+    const __m256d rotorRe = _mm256_loadu_pd(v.rotorRe + i);
+    const __m256d rotorIm = _mm256_loadu_pd(v.rotorIm + i);
+
+    const __m256d nextRe = _mm256_sub_pd(_mm256_mul_pd(re, rotorRe), _mm256_mul_pd(im, rotorIm));
+    const __m256d nextIm = _mm256_add_pd(_mm256_mul_pd(re, rotorIm), _mm256_mul_pd(im, rotorRe));
+    _mm256_storeu_pd(v.re + i, nextRe);
+    _mm256_storeu_pd(v.im + i, nextIm);
+
+    // The last lane carries the sum so far into the next four
+    const __m256d sumX = _mm256_add_pd(Scan(nextRe), x);
+    const __m256d sumY = _mm256_add_pd(Scan(nextIm), y);
+    _mm256_storeu_pd(v.sumX + i, sumX);
+    _mm256_storeu_pd(v.sumY + i, sumY);
+    x = _mm256_permute4x64_pd(sumX, _MM_SHUFFLE(3, 3, 3, 3));
+    y = _mm256_permute4x64_pd(sumY, _MM_SHUFFLE(3, 3, 3, 3));
+  }
+
+  AdvanceScalar(v, i, end);
+}
+#endif
+
+inline HarmonicsKernel SelectHarmonicsKernel(const char** name = nullptr)
+{
+  static const cpu::Option<HarmonicsKernel> kernels[] = {
+#if defined(__x86_64__)
+    {cpu::AVX2, "avx2", AdvanceAvx2},
+#endif
+    {cpu::BASELINE, "scalar", AdvanceScalar},
+  };
+
+  return cpu::Select(kernels, name);
+}
+
+// Sum of rotating phasors stored as a structure of arrays. A frame turns every
+// phasor by a complex multiplication with its rotor instead of going through
+// its angle, and the running sums are built in the same pass. The rounding of
+// the repeated products makes the lengths drift, so every HARMONICS_RENORMALISE
+// frames they are scaled back to their amplitudes.
+class Harmonics
+{
+public:
+  Harmonics()
+    : mKernel(SelectHarmonicsKernel(&mKernelName))
+  {}
+
+  // A phasor of the given length and starting angle turning by -frequency
+  // radians per frame
+  void Add(double amplitude, double phase, double frequency)
+  {
+    mAmplitude.push_back(amplitude);
+    mFrequency.push_back(frequency);
+    mRe.push_back(amplitude * std::cos(phase));
+    mIm.push_back(amplitude * std::sin(phase));
+    mRotorRe.push_back(std::cos(-frequency));
+    mRotorIm.push_back(std::sin(-frequency));
+
+    mSumX.push_back((mSumX.empty() ? 0 : mSumX.back()) + mRe.back());
+    mSumY.push_back((mSumY.empty() ? 0 : mSumY.back()) + mIm.back());
+  }
+
+  size_t Size() const
+  {
+    return mRe.size();
+  }
+
+  double Frequency(size_t i) const
+  {
+    return mFrequency[i];
+  }
+
+  double Amplitude(size_t i) const
+  {
+    return mAmplitude[i];
+  }
+
+  // Current phasor of harmonic i
+  double Re(size_t i) const
+  {
+    return mRe[i];
+  }
+
+  double Im(size_t i) const
+  {
+    return mIm[i];
+  }
+
+  void ScaleFrequencies(double factor)
+  {
+    for (size_t i = 0; i < mFrequency.size(); ++i)
+    {
+      mFrequency[i] *= factor;
+      mRotorRe[i] = std::cos(-mFrequency[i]);
+      mRotorIm[i] = std::sin(-mFrequency[i]);
+    }
+  }
+
+  // Turn every phasor one frame and recompute the running sums
+  void Advance()
+  {
+    const HarmonicsView view{mRe.data(), mIm.data(), mRotorRe.data(), mRotorIm.data(), mSumX.data(), mSumY.data()};
+    mKernel(view, 0, Size());
+
+    if (++mFrames % HARMONICS_RENORMALISE == 0)
+      Renormalise();
+  }
+
+  // Sum of the first i + 1 phasors
+  double SumX(size_t i) const
+  {
+    return mSumX[i];
+  }
+
+  double SumY(size_t i) const
+  {
+    return mSumY[i];
+  }
+
+  const char* KernelName() const
+  {
+    return mKernelName;
+  }
+
+private:
+  void Renormalise()
+  {
+    for (size_t i = 0; i < Size(); ++i)
+    {
+      const double length = std::hypot(mRe[i], mIm[i]);
+      if (length == 0)
+        continue;
+
+      mRe[i] *= mAmplitude[i] / length;
+      mIm[i] *= mAmplitude[i] / length;
+    }
+  }
+
+  std::vector<double> mAmplitude;
+  std::vector<double> mFrequency;
+
+  std::vector<double> mRe;
+  std::vector<double> mIm;
+  std::vector<double> mRotorRe;
+  std::vector<double> mRotorIm;
+
+  std::vector<double> mSumX;
+  std::vector<double> mSumY;
+
+  const char* mKernelName;
+  const HarmonicsKernel mKernel;
+  uint64_t mFrames = 0;
+};
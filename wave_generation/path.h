@@ -0,0 +1,120 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "fourier.h"
+#include "mapped_file.h"
+
+namespace path
+{
+
+inline bool EndsWith(const char* text, const char* suffix)
+{
+  const size_t length = strlen(text), suffixLength = strlen(suffix);
+  return length >= suffixLength && !strcmp(text + length - suffixLength, suffix);
+}
+
+// Numbers of one line separated by commas, semicolons or blanks. Returns how
+// many were read, at most two.
+inline int ParseLine(const char* it, const char* end, double values[2])
+{
+  int count = 0;
+  while (it < end && count < 2)
+  {
+    while (it < end && (*it == ' ' || *it == '\t' || *it == ',' || *it == ';' || *it == '\r' || *it == '+'))
+      ++it;
+
+    if (it == end || *it == '#')
+      break;
+
+    const auto result = std::from_chars(it, end, values[count]);
+    if (result.ec != std::errc())
+      return -1;
+
+    it = result.ptr;
+    ++count;
+  }
+
+  return count;
+}
+
+// One point per line, "x, y" for a path or a single value for a signal that
+// is drawn as a vertical line. Lines starting with '#' are comments, and a
+// first line that is not numbers is a header like the "x,y" of a CSV export.
+inline bool ParseText(const char* it, const char* end, std::vector<Complex>& points)
+{
+  bool first = true;
+  while (it < end)
+  {
+    const void* newline = memchr(it, '\n', end - it);
+    const char* lineEnd = newline ? static_cast<const char*>(newline) : end;
+
+    double values[2];
+    const int count = ParseLine(it, lineEnd, values);
+    if (count < 0 && !first)
+      return false;
+    if (count == 1)
+      points.push_back({0, values[0]});
+    else if (count == 2)
+      points.push_back({values[0], values[1]});
+
+    first = first && count == 0;
+    it = lineEnd + (newline != nullptr);
+  }
+
+  return true;
+}
+
+} // namespace path
+
+// Points of a closed path from a text file or, for ".bin" files, from native
+// pairs of doubles. The path is moved to be centred on the origin, flipped to
+// have y point down like the screen and scaled so its farthest point is at
+// `radius`.
+inline bool LoadPath(const char* file, double radius, std::vector<Complex>& points)
+{
+  points.clear();
+
+  MappedFile mapped(file);
+  if (!mapped.Valid())
+    return false;
+
+  const size_t size = mapped.End() - mapped.Begin();
+  if (path::EndsWith(file, ".bin"))
+  {
+    if (size % (2 * sizeof(double)))
+      return false;
+
+    points.resize(size / (2 * sizeof(double)));
+    memcpy(points.data(), mapped.Begin(), size);
+  }
+  else if (!path::ParseText(mapped.Begin(), mapped.End(), points))
+  {
+    return false;
+  }
+
+  if (points.empty())
+    return false;
+
+  Complex centre = 0;
+  for (const Complex& p : points)
+    centre += p;
+  centre /= double(points.size());
+
+  double farthest = 0;
+  for (Complex& p : points)
+  {
+    p = std::conj(p - centre);
+    farthest = std::max(farthest, std::abs(p));
+  }
+
+  if (farthest > 0)
+    for (Complex& p : points)
+      p *= radius / farthest;
+
+  return true;
+}
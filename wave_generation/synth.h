@@ -0,0 +1,270 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "cpu_dispatch.h"
+#include "harmonics.h"
+
+#define SYNTH_RATE 48000
+#define SYNTH_BLOCK 256
+#define SYNTH_LANES 8
+#define SYNTH_VOLUME 0.5
+
+// Hertz per radian per frame of a harmonic, puts the fundamental of the
+// square wave (0.02 radians per frame) at 220 Hz
+#define SYNTH_HZ_PER_RADIAN 11000.0
+
+// One partial as seen by the kernels. Its phasor turns by `rotor` every sample,
+// so the SYNTH_LANES samples following the current one are the phasor times
+// the first powers of the rotor, and the phasor then jumps SYNTH_LANES samples
+// ahead with `stride`.
+struct Partial
+{
+  alignas(32) float powerRe[SYNTH_LANES];
+  alignas(32) float powerIm[SYNTH_LANES];
+
+  double re;
+  double im;
+  double strideRe;
+  double strideIm;
+
+  double amplitude;
+  double frequency;
+};
+
+// Add the height of the partial over `count` samples, a multiple of
+// SYNTH_LANES, to `out`
+using SynthKernel = void (*)(Partial&, float*, size_t);
+
+inline void RenderScalar(Partial& p, float* out, size_t count)
+{
+  for (size_t s = 0; s < count; s += SYNTH_LANES)
+  {
+    const float re = p.re, im = p.im;
+    for (size_t lane = 0; lane < SYNTH_LANES; ++lane)
+      out[s + lane] += re * p.powerIm[lane] + im * p.powerRe[lane];
+
+    const double nextRe = p.re * p.strideRe - p.im * p.strideIm;
+    p.im = p.re * p.strideIm + p.im * p.strideRe;
+    p.re = nextRe;
+  }
+}
+
+#if defined(__x86_64__)
+__attribute__((target("avx2")))
+inline void RenderAvx2(Partial& p, float* out, size_t count)
+{
+  const __m256 powerRe = _mm256_load_ps(p.powerRe);
+  const __m256 powerIm = _mm256_load_ps(p.powerIm);
+
+  for (size_t s = 0; s < count; s += SYNTH_LANES)
+  {
+    const __m256 re = _mm256_set1_ps(p.re);
+    const __m256 im = _mm256_set1_ps(p.im);
+    const __m256 height = _mm256_add_ps(_mm256_mul_ps(re, powerIm), _mm256_mul_ps(im, powerRe));
+    _mm256_storeu_ps(out + s, _mm256_add_ps(_mm256_loadu_ps(out + s), height));
+
+    const double nextRe = p.re * p.strideRe - p.im * p.strideIm;
+    p.im = p.re * p.strideIm + p.im * p.strideRe;
+    p.re = nextRe;
+  }
+}
+#endif
+
+inline SynthKernel SelectSynthKernel(const char** name = nullptr)
+{
+  static const cpu::Option<SynthKernel> kernels[] = {
+#if defined(__x86_64__)
+    {cpu::AVX2, "avx2", RenderAvx2},
+#endif
+    {cpu::BASELINE, "scalar", RenderScalar},
+  };
+
+  return cpu::Select(kernels, name);
+}
+
+// Additive synthesis of the same harmonics that are drawn: the output is the
+// height of their sum, with every frequency turned from radians per frame into
+// an audible pitch. Samples are made a block of SYNTH_BLOCK at a time, each
+// partial adding SYNTH_LANES samples per step, and partials above the Nyquist
+// frequency are left out.
+//
+// Render() runs on the audio thread and never allocates or locks. The UI only
+// writes the frequency scale, an atomic the audio thread reads once per block;
+// when it changed the rotors are rebuilt while the phases carry on.
+class Synth
+{
+public:
+  explicit Synth(const Harmonics& harmonics)
+    : mKernel(SelectSynthKernel(&mKernelName))
+  {
+    mPartials.resize(harmonics.Size());
+    for (size_t i = 0; i < harmonics.Size(); ++i)
+    {
+      Partial& p = mPartials[i];
+      p.re = harmonics.Re(i);
+      p.im = harmonics.Im(i);
+      p.amplitude = harmonics.Amplitude(i);
+      p.frequency = harmonics.Frequency(i);
+    }
+
+    mActive.reserve(mPartials.size());
+    Tune(1);
+  }
+
+  // Called from the UI thread, multiplies every frequency like Harmonics does
+  void ScaleFrequencies(double factor)
+  {
+    mScale.store(mScale.load(std::memory_order_relaxed) * factor, std::memory_order_release);
+  }
+
+  // Fill `count` mono samples, called from the audio thread
+  void Render(float* out, size_t count)
+  {
+    while (count > 0)
+    {
+      if (mRead == SYNTH_BLOCK)
+        NextBlock();
+
+      const size_t taken = std::min<size_t>(count, SYNTH_BLOCK - mRead);
+      std::copy(mBlock + mRead, mBlock + mRead + taken, out);
+      mRead += taken;
+      out += taken;
+      count -= taken;
+    }
+  }
+
+  // Render `seconds` of sound into a 16 bit mono WAV file
+  bool WriteWav(const char* file, double seconds)
+  {
+    FILE* wav = fopen(file, "wb");
+    if (!wav)
+      return false;
+
+    const uint32_t samples = uint32_t(seconds * SYNTH_RATE);
+    const uint32_t bytes = samples * 2;
+    const uint32_t rate = SYNTH_RATE, byteRate = SYNTH_RATE * 2, formatSize = 16, riffSize = 36 + bytes;
+    const uint16_t pcm = 1, channels = 1, align = 2, bits = 16;
+
+    fwrite("RIFF", 1, 4, wav);
+    fwrite(&riffSize, 4, 1, wav);
+    fwrite("WAVEfmt ", 1, 8, wav);
+    fwrite(&formatSize, 4, 1, wav);
+    fwrite(&pcm, 2, 1, wav);
+    fwrite(&channels, 2, 1, wav);
+    fwrite(&rate, 4, 1, wav);
+    fwrite(&byteRate, 4, 1, wav);
+    fwrite(&align, 2, 1, wav);
+    fwrite(&bits, 2, 1, wav);
+    fwrite("data", 1, 4, wav);
+    fwrite(&bytes, 4, 1, wav);
+
+    float block[SYNTH_BLOCK];
+    int16_t pcmBlock[SYNTH_BLOCK];
+    for (uint32_t written = 0; written < samples; written += SYNTH_BLOCK)
+    {
+      const size_t count = std::min<uint32_t>(SYNTH_BLOCK, samples - written);
+      Render(block, count);
+      for (size_t s = 0; s < count; ++s)
+        pcmBlock[s] = int16_t(std::max(-1.0f, std::min(1.0f, block[s])) * 32767);
+
+      fwrite(pcmBlock, 2, count, wav);
+    }
+
+    return fclose(wav) == 0;
+  }
+
+  // Partials below the Nyquist frequency at the current scale
+  size_t Audible() const
+  {
+    return mActive.size();
+  }
+
+  const char* KernelName() const
+  {
+    return mKernelName;
+  }
+
+private:
+  void NextBlock()
+  {
+    const double scale = mScale.load(std::memory_order_acquire);
+    if (scale != mTuned)
+      Tune(scale);
+
+    std::fill(mBlock, mBlock + SYNTH_BLOCK, 0.0f);
+    for (uint32_t i : mActive)
+    {
+      Partial& p = mPartials[i];
+      mKernel(p, mBlock, SYNTH_BLOCK);
+
+      // Keep the rounding of the repeated products from changing the volume
+      const double length = std::hypot(p.re, p.im);
+      if (length > 0)
+      {
+        p.re *= p.amplitude / length;
+        p.im *= p.amplitude / length;
+      }
+    }
+
+    for (float& sample : mBlock)
+      sample *= mGain;
+
+    mRead = 0;
+  }
+
+  // Rotors and powers of every audible partial for a frequency scale
+  void Tune(double scale)
+  {
+    mTuned = scale;
+    mActive.clear();
+
+    double total = 0;
+    for (uint32_t i = 0; i < mPartials.size(); ++i)
+    {
+      Partial& p = mPartials[i];
+      const double hz = std::abs(p.frequency * scale) * SYNTH_HZ_PER_RADIAN;
+      if (hz >= SYNTH_RATE / 2 || p.amplitude == 0)
+        continue;
+
+      const double step = -p.frequency * scale * SYNTH_HZ_PER_RADIAN * 2 * M_PI / SYNTH_RATE;
+      for (int lane = 0; lane < SYNTH_LANES; ++lane)
+      {
+        p.powerRe[lane] = std::cos(step * lane);
+        p.powerIm[lane] = std::sin(step * lane);
+      }
+
+      p.strideRe = std::cos(step * SYNTH_LANES);
+      p.strideIm = std::sin(step * SYNTH_LANES);
+
+      mActive.push_back(i);
+      total += p.amplitude;
+    }
+
+    mGain = total > 0 ? SYNTH_VOLUME / total : 0;
+  }
+
+  std::vector<Partial> mPartials;
+  std::vector<uint32_t> mActive;
+  float mGain = 0;
+
+  // Written by the UI thread, the value the partials are tuned to is only
+  // touched by the audio thread
+  std::atomic<double> mScale{1};
+  double mTuned = 0;
+
+  float mBlock[SYNTH_BLOCK];
+  size_t mRead = SYNTH_BLOCK;
+
+  const char* mKernelName;
+  const SynthKernel mKernel;
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+// The last `capacity` samples of a trace in a ring that is allocated once. A
+// new sample overwrites the oldest one, and samples are addressed by age with
+// 0 the newest, so scrolling the trace is a matter of drawing sample `age` one
+// pixel further along per age instead of moving anything in memory.
+template <typename T>
+class TraceHistory
+{
+public:
+  explicit TraceHistory(size_t capacity)
+    : mSamples(capacity)
+  {}
+
+  void Push(const T& sample)
+  {
+    if (mSamples.empty())
+      return;
+
+    mNewest = (mNewest + 1) % mSamples.size();
+    mSamples[mNewest] = sample;
+    if (mSize < mSamples.size())
+      ++mSize;
+  }
+
+  void Clear()
+  {
+    mSize = 0;
+  }
+
+  // Keep `size` samples, new ones are to be written by age
+  void Resize(size_t size)
+  {
+    mSize = std::min(size, mSamples.size());
+  }
+
+  size_t Size() const
+  {
+    return mSize;
+  }
+
+  size_t Capacity() const
+  {
+    return mSamples.size();
+  }
+
+  const T& operator[](size_t age) const
+  {
+    return mSamples[(mNewest + mSamples.size() - age) % mSamples.size()];
+  }
+
+  T& operator[](size_t age)
+  {
+    return mSamples[(mNewest + mSamples.size() - age) % mSamples.size()];
+  }
+
+private:
+  std::vector<T> mSamples;
+  size_t mNewest = 0;
+  size_t mSize = 0;
+};
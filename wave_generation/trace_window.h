@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include "harmonics.h"
+#include "thread_pool.h"
+#include "trace_history.h"
+
+#define TRACE_WINDOW_GRAIN 32
+
+// Rewrite the last `ages` samples of every trace from the harmonics as they
+// are now, as if the current frequencies had always been in use. Harmonic j
+// was z_j e^(i f_j a) a frames ago, so the traces are running sums of phasors
+// turned back by their age. Ages are split in chunks over the pool; a chunk
+// turns its phasors to its first age once and then steps them back one frame
+// at a time. `convert` makes a sample out of a running sum.
+template <typename T, typename Convert>
+void EvaluateTraces(const Harmonics& harmonics, size_t firstTraced, std::vector<TraceHistory<T>>& traces,
+                    size_t ages, ThreadPool& pool, const Convert& convert)
+{
+  const size_t count = harmonics.Size();
+  for (auto& trace : traces)
+  {
+    trace.Resize(ages);
+    ages = trace.Size();
+  }
+
+  pool.ParallelFor(0, ages, TRACE_WINDOW_GRAIN, [&](size_t begin, size_t end)
+  {
+    std::vector<double> re(count), im(count), stepRe(count), stepIm(count);
+    for (size_t j = 0; j < count; ++j)
+    {
+      const double f = harmonics.Frequency(j);
+      const double turnRe = std::cos(f * begin), turnIm = std::sin(f * begin);
+      re[j] = harmonics.Re(j) * turnRe - harmonics.Im(j) * turnIm;
+      im[j] = harmonics.Re(j) * turnIm + harmonics.Im(j) * turnRe;
+      stepRe[j] = std::cos(f);
+      stepIm[j] = std::sin(f);
+    }
+
+    for (size_t age = begin; age < end; ++age)
+    {
+      double x = 0, y = 0;
+      for (size_t j = 0; j < count; ++j)
+      {
+        x += re[j];
+        y += im[j];
+        if (j >= firstTraced)
+          traces[j - firstTraced][age] = convert(x, y);
+
+        const double nextRe = re[j] * stepRe[j] - im[j] * stepIm[j];
+        im[j] = re[j] * stepIm[j] + im[j] * stepRe[j];
+        re[j] = nextRe;
+      }
+    }
+  });
+}
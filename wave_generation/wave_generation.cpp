@@ -1,8 +1,19 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <memory>
 #include <vector>
 #include <random>
 
+#include "harmonics.h"
 #include "linalg.h"
+#include "path.h"
+#include "synth.h"
+#include "trace_history.h"
+#include "trace_window.h"
 
 #include <SDL2/SDL.h>
 
@@ -11,21 +22,94 @@ static const float FPS = 60.0;
 #define HEIGHT 600
 #define WAVES true
 #define RENDER_ALL false
+#define RECOMPUTE_TRACES true
 #define DEFINED_WAVE true
+#define PATH_FRAMES 1000
+#define PATH_RADIUS 30
 
-int main()
+// A wave only needs its height per frame, the path of the chain both coordinates
+#if WAVES
+using Sample = double;
+#else
+using Sample = linalg::Double2d;
+#endif
+
+// Screen position of a trace sample `age` frames old, the trace scrolls right
+// by one pixel per frame
+inline double SampleX(double, size_t age, int centerX)
+{
+  return centerX + double(age);
+}
+
+inline double SampleY(double sample)
+{
+  return sample;
+}
+
+inline double SampleX(const linalg::Double2d& sample, size_t age, int)
+{
+  return sample.X() + double(age);
+}
+
+inline double SampleY(const linalg::Double2d& sample)
+{
+  return sample.Y();
+}
+
+// The trace as one polyline, written into `line` which keeps its capacity
+// from frame to frame
+void DrawTrace(SDL_Renderer* renderer, const TraceHistory<Sample>& trace, int centerX, std::vector<SDL_FPoint>& line)
+{
+  line.clear();
+  for (size_t age = 0; age < trace.Size(); ++age)
+    line.push_back({float(SampleX(trace[age], age, centerX)), float(SampleY(trace[age]))});
+
+  if (line.size() > 1)
+    SDL_RenderDrawLinesF(renderer, line.data(), line.size());
+}
+
+int main(int argc, char* argv[])
 {
   srand(time(NULL));
 
-  std::vector<double> frequencies;
+  int waves = 50;
+  const char* pathFile = nullptr;
+  const char* wavFile = nullptr;
+  double wavSeconds = 0;
+  bool audio = false;
+  for (int i = 1; i < argc; ++i)
+  {
+    if (!strcmp(argv[i], "--waves") && i + 1 < argc)
+    {
+      waves = std::max(1, atoi(argv[++i]));
+    }
+    else if (!strcmp(argv[i], "--path") && i + 1 < argc)
+    {
+      pathFile = argv[++i];
+    }
+    else if (!strcmp(argv[i], "--audio"))
+    {
+      audio = true;
+    }
+    else if (!strcmp(argv[i], "--wav") && i + 2 < argc)
+    {
+      wavFile = argv[++i];
+      wavSeconds = atof(argv[++i]);
+    }
+    else
+    {
+      printf("Usage: %s [--waves n] [--path file.csv|file.bin] [--audio] [--wav file.wav seconds]\n", argv[0]);
+      return -1;
+    }
+  }
+
+  Harmonics harmonics;
   std::vector<SDL_Color> colors;
-  std::vector<std::vector<linalg::Double2d>> points;
-  std::vector<linalg::Double2d> signals;
+  std::vector<TraceHistory<Sample>> points;
 
   bool run = true;
 
   int scale = 8;
-  int waves = 50;
   int centerX = WIDTH / 12;
   int centerY = HEIGHT / 2;
 
@@ -33,32 +117,109 @@ int main()
   double multi = 1;
   double mag = (4 / M_PI) * 20;
 
+  // A loaded path is drawn by its largest Fourier terms, one loop every PATH_FRAMES frames
+  std::vector<Epicycle> epicycles;
+  if (pathFile)
+  {
+    std::vector<Complex> path;
+    if (!LoadPath(pathFile, PATH_RADIUS, path) || (epicycles = Epicycles(path, waves)).empty())
+    {
+      printf("Failed to load %s\n", pathFile);
+      return -1;
+    }
+
+    waves = epicycles.size();
+  }
+
   // Initialize all randomized parameters
   for (int i = 1; i < waves + 1; i++)
   {
+    if (pathFile)
+    {
+      const Epicycle& epicycle = epicycles[i - 1];
+      harmonics.Add(epicycle.amplitude, epicycle.phase, -2 * M_PI * epicycle.frequency / PATH_FRAMES);
+    }
+    else
+    {
 #if DEFINED_WAVE
-    // For specific waves, now set to square wave
-    signals.push_back(linalg::Double2d((mag / multi), phase, linalg::Format::Polar));
-    frequencies.push_back(0.01 * multi * 2);
-    multi += 2;
+      // For specific waves, now set to square wave
+      harmonics.Add(mag / multi, phase, 0.01 * multi * 2);
+      multi += 2;
 #else
-    // For random waves
-    signals.push_back(linalg::Double2d(i, phase, linalg::Format::Polar));
-    frequencies.push_back(double(rand() % 200 - 100) / 1000);
-    phase += M_PI / (rand() % 10 + 1);
+      // For random waves
+      harmonics.Add(i, phase, double(rand() % 200 - 100) / 1000);
+      phase += M_PI / (rand() % 10 + 1);
 #endif
+    }
 
     colors.push_back({uint8_t(rand() % 255),
                       uint8_t(rand() % 255),
                       uint8_t(rand() % 255),
                       (uint8_t)std::min((rand() % 50) * (i + 1), 255) });
+  }
+
+  // Only the traces that are drawn are recorded, each a screen width long
+  const size_t firstTraced = RENDER_ALL ? 0 : harmonics.Size() - 1;
+  points.assign(harmonics.Size() - firstTraced, TraceHistory<Sample>(WIDTH));
+
+  // Screen sample of a running sum of the harmonics
+  auto toSample = [&](double x, double y)
+  {
+#if WAVES
+    return Sample(centerY + scale * y);
+#else
+    return Sample(centerX + scale * x, centerY + scale * y);
+#endif
+  };
+
+  // After a frequency change the visible traces are evaluated again instead of
+  // scrolling the old ones out
+  ThreadPool pool(RECOMPUTE_TRACES ? 0 : 1);
+  bool retrace = false;
 
-    points.push_back({});
+  // Write the sound of the harmonics and quit, no window or audio device needed
+  if (wavFile)
+  {
+    Synth synth(harmonics);
+    const auto begin = std::chrono::steady_clock::now();
+    if (!synth.WriteWav(wavFile, wavSeconds))
+    {
+      printf("Failed to write %s\n", wavFile);
+      return -1;
+    }
+
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    printf("%zu of %zu partials audible, %.1f s rendered in %.3f s with %s\n",
+           synth.Audible(), harmonics.Size(), wavSeconds, elapsed, synth.KernelName());
+    return 0;
   }
 
-  linalg::Double2d yAxis(4, -M_PI / 2, linalg::Format::Polar);
+  SDL_Init(SDL_INIT_VIDEO | (audio ? SDL_INIT_AUDIO : 0));
 
-  SDL_Init(SDL_INIT_VIDEO);
+  // The synth plays on SDL's audio thread one block at a time
+  std::unique_ptr<Synth> synth;
+  SDL_AudioDeviceID device = 0;
+  if (audio)
+  {
+    synth.reset(new Synth(harmonics));
+
+    SDL_AudioSpec want = {}, have;
+    want.freq = SYNTH_RATE;
+    want.format = AUDIO_F32SYS;
+    want.channels = 1;
+    want.samples = SYNTH_BLOCK;
+    want.userdata = synth.get();
+    want.callback = [](void* userdata, Uint8* stream, int length)
+    {
+      static_cast<Synth*>(userdata)->Render(reinterpret_cast<float*>(stream), length / sizeof(float));
+    };
+
+    device = SDL_OpenAudioDevice(nullptr, 0, &want, &have, 0);
+    if (device)
+      SDL_PauseAudioDevice(device, 0);
+    else
+      printf("Failed to open audio: %s\n", SDL_GetError());
+  }
 
   SDL_DisplayMode DM;
   SDL_GetCurrentDisplayMode(0, &DM);
@@ -72,6 +233,12 @@ int main()
 
   SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
 
+  // Screen points of the epicycle chain and of one trace, reused every frame
+  std::vector<SDL_FPoint> chain;
+  std::vector<SDL_FPoint> line;
+  chain.reserve(harmonics.Size() + 1);
+  line.reserve(WIDTH);
+
   while (run)
   {
     uint32_t start = SDL_GetTicks();
@@ -87,13 +254,17 @@ int main()
       }
       else if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_UP)
       {
-        for (auto& f : frequencies)
-          f *= 0.01;
+        harmonics.ScaleFrequencies(0.01);
+        if (synth)
+          synth->ScaleFrequencies(0.01);
+        retrace = RECOMPUTE_TRACES;
       }
       else if ((event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_DOWN))
       {
-        for (auto& f : frequencies)
-          f /= 0.01;
+        harmonics.ScaleFrequencies(1 / 0.01);
+        if (synth)
+          synth->ScaleFrequencies(1 / 0.01);
+        retrace = RECOMPUTE_TRACES;
       }
     }
 
@@ -102,81 +273,48 @@ int main()
 
     SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
 
-    linalg::Double2d vec;
-    std::vector<linalg::Double2d> toDraw;
-    for (int i = 0; i < signals.size(); ++i)
+    // Running sums of all harmonics, their projection on the y axis is the wave
+    harmonics.Advance();
+
+    chain.clear();
+    chain.push_back({float(centerX), float(centerY)});
+    for (size_t i = 0; i < harmonics.Size(); ++i)
     {
-      signals.at(i) = signals.at(i).RotateZ(-frequencies.at(i));
-      vec += signals.at(i);
-      auto proj = vec.Projection(yAxis);
+      const linalg::Double2d vec(harmonics.SumX(i), harmonics.SumY(i));
+      chain.push_back({float(centerX + scale * vec.X()), float(centerY + scale * vec.Y())});
 
-      toDraw.push_back(vec);
+      if (i >= firstTraced && !retrace)
+        points[i - firstTraced].Push(toSample(vec.X(), vec.Y()));
+    }
 
-#if WAVES
-      points.at(i).push_back(linalg::Double2d(centerX + scale * proj.X(), centerY + scale * proj.Y()));
-#else
-      points.at(i).push_back(linalg::Double2d(centerX + scale * vec.X(), centerY + scale * vec.Y()));
-#endif
+    if (retrace)
+    {
+      EvaluateTraces(harmonics, firstTraced, points, WIDTH, pool, toSample);
+      retrace = false;
     }
 
     // Draw glob of rotating lines
-    SDL_RenderDrawLine(renderer, centerX, centerY, centerX + scale * toDraw.at(0).X(), centerY + scale * toDraw.at(0).Y());
-    for (int i = 1; i < toDraw.size(); ++i)
-      SDL_RenderDrawLine(renderer,
-                          centerX + scale * toDraw.at(i - 1).X(),
-                          centerY + scale * toDraw.at(i - 1).Y(),
-                          centerX + scale * toDraw.at(i).X(),
-                          centerY + scale * toDraw.at(i).Y());
-
-    // Draw guide line
-    auto proj = vec.Projection(yAxis);
-    SDL_SetRenderDrawColor(renderer, 0, 0, 255, 255);
-    SDL_RenderDrawLine(renderer, centerX, centerY, centerX + scale * proj.X(), centerY + scale * proj.Y());
-    SDL_RenderDrawLine(renderer,
-                       centerX + scale * proj.X(),
-                       centerY + scale * proj.Y(),
-                       centerX + scale * toDraw.back().X(),
-                       centerY + scale * toDraw.back().Y());
-
-#if RENDER_ALL
-    for (int i = 0; i < points.size(); ++i)
-    {
-      SDL_SetRenderDrawColor(renderer, colors[i].r, colors[i].g, colors[i].b, colors[i].a);
-      for (auto iter = points[i].begin(); iter < points[i].end(); ++iter)
-      {
-        if (iter != points[i].begin())
-        {
-          auto prev = iter - 1;
-          SDL_RenderDrawLine(renderer, iter->X(), iter->Y(), prev->X(), prev->Y());
-        }
+    SDL_RenderDrawLinesF(renderer, chain.data(), chain.size());
 
-        *iter = *iter + linalg::Double2d(1, 0);
-      }
+    // Draw guide line, from the centre up to the height of the tip and across to it
+    const SDL_FPoint guide[3] = {chain.front(), {chain.front().x, chain.back().y}, chain.back()};
+    SDL_SetRenderDrawColor(renderer, 0, 0, 255, 255);
+    SDL_RenderDrawLinesF(renderer, guide, 3);
 
-      if (points[i].size() > WIDTH)
-        points[i].erase(points[i].begin());
-    }
-#else
-    SDL_SetRenderDrawColor(renderer, colors.back().r, colors.back().g, colors.back().b, colors.back().a);
-    for (auto iter = points.back().begin(); iter < points.back().end(); ++iter)
+    for (size_t i = 0; i < points.size(); ++i)
     {
-      if (iter != points.back().begin())
-      {
-        auto prev = iter - 1;
-        SDL_RenderDrawLine(renderer, iter->X(), iter->Y(), prev->X(), prev->Y());
-      }
-
-      *iter = *iter + linalg::Double2d(1, 0);
+      const SDL_Color& color = colors[firstTraced + i];
+      SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
+      DrawTrace(renderer, points[i], centerX, line);
     }
 
-    if (points.back().size() > WIDTH)
-      points.back().erase(points.back().begin());
-#endif
-
     SDL_RenderPresent(renderer);
     SDL_Delay(1000 / FPS);
   }
 
+  if (device)
+    SDL_CloseAudioDevice(device);
+
   SDL_Quit();
 
   return 0;
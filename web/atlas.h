@@ -0,0 +1,216 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+
+// Empty texels around every sprite so filtering never reads a neighbour
+#define ATLAS_PADDING 1
+
+namespace atlas
+{
+
+// Every file under `directory` ending in `extension`, with the directory prefixed
+inline void FindFiles(const std::string& directory, const char* extension, std::vector<std::string>& files)
+{
+  DIR* dir = opendir(directory.c_str());
+  if (!dir)
+    return;
+
+  const size_t extensionLength = strlen(extension);
+  while (dirent* entry = readdir(dir))
+  {
+    if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, ".."))
+      continue;
+
+    const std::string path = directory + "/" + entry->d_name;
+    struct stat info;
+    if (stat(path.c_str(), &info))
+      continue;
+
+    if (S_ISDIR(info.st_mode))
+      FindFiles(path, extension, files);
+    else if (path.size() >= extensionLength && !path.compare(path.size() - extensionLength, extensionLength, extension))
+      files.push_back(path);
+  }
+
+  closedir(dir);
+}
+
+// Shelf packing: sprites are placed tallest first in rows across an atlas
+// `width` wide, a row as tall as its first sprite. Returns false when the rows
+// do not fit in `maxHeight`, otherwise the used height.
+inline bool PackShelves(const std::vector<SDL_Rect>& sizes, int width, int maxHeight, std::vector<SDL_Rect>& rects, int& height)
+{
+  std::vector<size_t> order(sizes.size());
+  for (size_t i = 0; i < order.size(); ++i)
+    order[i] = i;
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sizes[a].h > sizes[b].h; });
+
+  rects.assign(sizes.size(), SDL_Rect{0, 0, 0, 0});
+  int x = 0, y = 0, shelf = 0;
+  for (size_t i : order)
+  {
+    const int w = sizes[i].w + 2 * ATLAS_PADDING;
+    const int h = sizes[i].h + 2 * ATLAS_PADDING;
+    if (w > width)
+      return false;
+
+    if (x + w > width)
+    {
+      y += shelf;
+      x = shelf = 0;
+    }
+
+    if (y + h > maxHeight)
+      return false;
+
+    rects[i] = {x + ATLAS_PADDING, y + ATLAS_PADDING, sizes[i].w, sizes[i].h};
+    x += w;
+    shelf = std::max(shelf, h);
+  }
+
+  height = y + shelf;
+  return true;
+}
+
+inline int PowerOfTwo(int n)
+{
+  int power = 1;
+  while (power < n)
+    power <<= 1;
+  return power;
+}
+
+} // namespace atlas
+
+// Every PNG of a directory tree packed into one texture at startup, so any
+// number of sprites can be drawn from it with a single call. Sprites are
+// looked up by the path they were loaded from.
+class Atlas
+{
+public:
+  ~Atlas()
+  {
+    if (mTexture)
+      SDL_DestroyTexture(mTexture);
+  }
+
+  Atlas() = default;
+  Atlas(const Atlas&) = delete;
+  Atlas& operator=(const Atlas&) = delete;
+
+  bool Load(SDL_Renderer* renderer, const std::string& directory)
+  {
+    std::vector<std::string> files;
+    atlas::FindFiles(directory, ".png", files);
+    std::sort(files.begin(), files.end());
+
+    std::vector<SDL_Surface*> images;
+    std::vector<SDL_Rect> sizes;
+    for (const auto& file : files)
+    {
+      SDL_Surface* image = IMG_Load(file.c_str());
+      if (!image)
+        continue;
+
+      mNames.push_back(file);
+      images.push_back(image);
+      sizes.push_back({0, 0, image->w, image->h});
+    }
+
+    SDL_RendererInfo info;
+    SDL_GetRendererInfo(renderer, &info);
+    const int maxSize = info.max_texture_width > 0 ? std::min(info.max_texture_width, info.max_texture_height) : 2048;
+
+    // Narrowest power of two width, from the side of a square of the same
+    // area, whose shelves fit in the largest texture
+    int area = 0, widest = 0;
+    for (const auto& size : sizes)
+    {
+      area += (size.w + 2 * ATLAS_PADDING) * (size.h + 2 * ATLAS_PADDING);
+      widest = std::max(widest, size.w + 2 * ATLAS_PADDING);
+    }
+
+    mWidth = atlas::PowerOfTwo(std::max<int>(widest, std::sqrt(area)));
+    while (mWidth <= maxSize && !atlas::PackShelves(sizes, mWidth, maxSize, mRects, mHeight))
+      mWidth *= 2;
+
+    if (mWidth <= maxSize && !images.empty())
+    {
+      mHeight = atlas::PowerOfTwo(mHeight);
+      SDL_Surface* sheet = SDL_CreateRGBSurfaceWithFormat(0, mWidth, mHeight, 32, SDL_PIXELFORMAT_RGBA32);
+      SDL_FillRect(sheet, nullptr, SDL_MapRGBA(sheet->format, 0, 0, 0, 0));
+      for (size_t i = 0; i < images.size(); ++i)
+      {
+        // Copy the pixels as they are, alpha included
+        SDL_SetSurfaceBlendMode(images[i], SDL_BLENDMODE_NONE);
+        SDL_BlitSurface(images[i], nullptr, sheet, &mRects[i]);
+      }
+
+      mTexture = SDL_CreateTextureFromSurface(renderer, sheet);
+      SDL_SetTextureBlendMode(mTexture, SDL_BLENDMODE_BLEND);
+      SDL_FreeSurface(sheet);
+    }
+
+    for (SDL_Surface* image : images)
+      SDL_FreeSurface(image);
+
+    if (!mTexture)
+    {
+      mNames.clear();
+      mRects.clear();
+    }
+
+    return mTexture != nullptr;
+  }
+
+  // Index of the sprite loaded from `file`, -1 if there is none
+  int Find(const std::string& file) const
+  {
+    const auto it = std::find(mNames.begin(), mNames.end(), file);
+    return it == mNames.end() ? -1 : int(it - mNames.begin());
+  }
+
+  size_t Size() const
+  {
+    return mRects.size();
+  }
+
+  // Where sprite i is in the texture
+  const SDL_Rect& Rect(int sprite) const
+  {
+    return mRects[sprite];
+  }
+
+  SDL_Texture* Texture() const
+  {
+    return mTexture;
+  }
+
+  int Width() const
+  {
+    return mWidth;
+  }
+
+  int Height() const
+  {
+    return mHeight;
+  }
+
+private:
+  std::vector<std::string> mNames;
+  std::vector<SDL_Rect> mRects;
+
+  SDL_Texture* mTexture = nullptr;
+  int mWidth = 0;
+  int mHeight = 0;
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vector>
+
+#include <SDL2/SDL.h>
+
+#include "atlas.h"
+
+// Sprites of an atlas queued as textured quads and submitted with one
+// SDL_RenderGeometry call per flush, so the draw calls of a frame do not grow
+// with the number of sprites. Anything drawn another way in between has to
+// flush first to keep the painting order.
+class SpriteBatch
+{
+public:
+  explicit SpriteBatch(const Atlas& atlas)
+    : mAtlas(atlas)
+  {}
+
+  // Like SDL_RenderCopy, `part` is a rectangle within the sprite or null for all of it
+  void Draw(int sprite, const SDL_Rect* part, const SDL_Rect& dest, SDL_Color color = {255, 255, 255, 255})
+  {
+    SDL_Rect src = mAtlas.Rect(sprite);
+    if (part)
+      src = {src.x + part->x, src.y + part->y, part->w, part->h};
+
+    const float u0 = float(src.x) / mAtlas.Width(), v0 = float(src.y) / mAtlas.Height();
+    const float u1 = float(src.x + src.w) / mAtlas.Width(), v1 = float(src.y + src.h) / mAtlas.Height();
+
+    const float x0 = dest.x, y0 = dest.y;
+    const float x1 = dest.x + dest.w, y1 = dest.y + dest.h;
+    mVertices.push_back({{x0, y0}, color, {u0, v0}});
+    mVertices.push_back({{x1, y0}, color, {u1, v0}});
+    mVertices.push_back({{x1, y1}, color, {u1, v1}});
+    mVertices.push_back({{x0, y1}, color, {u0, v1}});
+  }
+
+  // Send every queued sprite, returns the number of draw calls made
+  int Flush(SDL_Renderer* renderer)
+  {
+    if (mVertices.empty())
+      return 0;
+
+    // Indices repeat the same two triangles per quad, only extend them when the batch grows
+    while (mIndices.size() / 6 < mVertices.size() / 4)
+    {
+      const int first = mIndices.size() / 6 * 4;
+      for (int i : {0, 1, 2, 0, 2, 3})
+        mIndices.push_back(first + i);
+    }
+
+    SDL_RenderGeometry(renderer, mAtlas.Texture(), mVertices.data(), mVertices.size(), mIndices.data(), mVertices.size() / 4 * 6);
+    mVertices.clear();
+    return 1;
+  }
+
+private:
+  const Atlas& mAtlas;
+
+  std::vector<SDL_Vertex> mVertices;
+  std::vector<int> mIndices;
+};
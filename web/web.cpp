@@ -3,8 +3,19 @@
 #include <SDL2/SDL_ttf.h>
 #include <vector>
 #include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
 #include <emscripten.h>
 
+#include "atlas.h"
+#include "boid_swarm.h"
+#include "boids/boid_batch.h"
+#include "sprite_batch.h"
+
+#define BOID_SIZE 5
+
 struct context {
  std::string title;
  int width, height;
@@ -14,6 +25,8 @@ struct context {
  Uint32 mousestate;
  SDL_Texture *screen;
  SDL_Rect screensize;
+ // Draw through the screen texture instead of straight to the backbuffer
+ bool offscreen = false;
  SDL_Event event;
  SDL_Color bkg = {0,255,255,255};
 
@@ -21,21 +34,34 @@ struct context {
  int setFPS = 60;
 
  int logo;
- std::vector<SDL_Texture*> images;
+ Atlas atlas;
+ SpriteBatch sprites{atlas};
+ std::vector<SDL_Point> extra;
+ int drawCalls = 0, lastDrawCalls = 0;
+
+ // The swarm of the core library, drawn with one call like the native demo
+ int boids = 0;
+ unsigned threads = 1;
+ std::unique_ptr<BoidSwarm> swarm;
+ std::unique_ptr<BoidBatch> flock;
 
  int font_size = 32;
  TTF_Font *font;
  SDL_Color font_color = {255,255,255,255};
 };
+// Every image under res/ is packed in the atlas at startup, -1 if filename is not
 int loadImage(std::string filename, context *ctx) {
- ctx->images.push_back(IMG_LoadTexture(ctx->renderer, filename.c_str()));
- return ctx->images.size()-1;
+ return ctx->atlas.Find(filename);
 }
 void drawImage(int img, SDL_Rect dest, SDL_Rect src, context *ctx) {
- SDL_RenderCopy(ctx->renderer, ctx->images[img], &src, &dest);
+ if (img >= 0) ctx->sprites.Draw(img, &src, dest);
+}
+void flushImages(context *ctx) {
+ ctx->drawCalls += ctx->sprites.Flush(ctx->renderer);
 }
 
 void writeText(std::string t, int x, int y, context *ctx) {
+ flushImages(ctx);
  const char *text = t.c_str();
  SDL_Surface *text_surface = TTF_RenderText_Solid(ctx->font, text, ctx->font_color);
  SDL_Texture *text_texture = SDL_CreateTextureFromSurface(ctx->renderer, text_surface);
@@ -43,6 +69,7 @@ void writeText(std::string t, int x, int y, context *ctx) {
  SDL_FreeSurface(text_surface);
  SDL_RenderCopy(ctx->renderer, text_texture, NULL, &wrect);
  SDL_DestroyTexture(text_texture);
+ ctx->drawCalls++;
 }
 
 void updateKeys(context *ctx) {
@@ -54,7 +81,7 @@ void updateKeys(context *ctx) {
 void setDrawColor(SDL_Color c, context *ctx) { SDL_SetRenderDrawColor(ctx->renderer, c.r, c.g, c.b, c.a); }
 
 void begin_render(context *ctx) {
-  SDL_SetRenderTarget(ctx->renderer, ctx->screen);
+  if (ctx->offscreen) SDL_SetRenderTarget(ctx->renderer, ctx->screen);
   setDrawColor(ctx->bkg, ctx);
   SDL_RenderClear(ctx->renderer);
   ctx->frameCount++;
@@ -65,20 +92,47 @@ void begin_render(context *ctx) {
 }
 
 void end_render(context *ctx) {
-  SDL_SetRenderTarget(ctx->renderer, NULL);
-  SDL_RenderCopy(ctx->renderer, ctx->screen, &ctx->screensize, &ctx->screensize);
+  flushImages(ctx);
+  if (ctx->offscreen) {
+   SDL_SetRenderTarget(ctx->renderer, NULL);
+   SDL_RenderCopy(ctx->renderer, ctx->screen, &ctx->screensize, &ctx->screensize);
+   ctx->drawCalls++;
+  }
   SDL_RenderPresent(ctx->renderer);
+  ctx->lastDrawCalls = ctx->drawCalls;
+  ctx->drawCalls = 0;
 }
 void init(context *ctx) {
  ctx->screensize.x=ctx->screensize.y=0;
  ctx->screensize.w=ctx->width;ctx->screensize.h=ctx->height;
- ctx->screen = SDL_CreateTexture(ctx->renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, ctx->width, ctx->height);
+ if (ctx->offscreen) ctx->screen = SDL_CreateTexture(ctx->renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, ctx->width, ctx->height);
 
+ if (!ctx->atlas.Load(ctx->renderer, "res")) std::cout << "No images packed from res/" << std::endl;
  ctx->logo = loadImage("res/logo-amg.png", ctx);
+ for (SDL_Point &p : ctx->extra) {
+  p.x = rand() % ctx->width;
+  p.y = rand() % ctx->height;
+ }
+ if (ctx->boids > 0) {
+  ctx->swarm.reset(new BoidSwarm(ctx->width, ctx->height, SteeringParameters(), ctx->threads));
+  for (int i = 0; i < ctx->boids; ++i) ctx->swarm->AddBoid();
+  ctx->flock.reset(new BoidBatch(ctx->renderer, BOID_SIZE, {255,255,255,200}));
+ }
  TTF_Init();
  ctx->font = TTF_OpenFont("res/Peepo.ttf", ctx->font_size);
 }
 
+void drawSwarm(context *ctx) {
+ BoidSwarm &swarm = *ctx->swarm;
+ swarm.Update(1, 1, 1);
+ flushImages(ctx);
+ ctx->flock->Clear();
+ for (size_t i = 0; i < swarm.Size(); ++i)
+  ctx->flock->Add(swarm.X(i), swarm.Y(i), swarm.Vx(i), swarm.Vy(i), BOID_SIZE);
+ ctx->flock->Draw(ctx->renderer);
+ ctx->drawCalls++;
+}
+
 void quit(context *ctx) {
  SDL_DestroyRenderer(ctx->renderer);
  SDL_Quit();
@@ -99,13 +153,30 @@ void loop(context *ctx) {
 void mainloop(void *arg) {
  context *ctx = static_cast<context*>(arg);
  loop(ctx);
+ for (const SDL_Point &p : ctx->extra)
+  drawImage(ctx->logo, {p.x, p.y, 38, 28}, {0,0,38,28}, ctx);
+ if (ctx->swarm) drawSwarm(ctx);
  drawImage(ctx->logo, {ctx->mouse.x, ctx->mouse.y, 38*4, 28*4}, {0,0,38,28}, ctx);
- writeText(std::to_string(ctx->fps), 10, 0, ctx);
+ std::string status = std::to_string(ctx->fps) + " fps " + std::to_string(ctx->lastDrawCalls) + " draws";
+ if (ctx->swarm) status += " " + std::to_string(ctx->swarm->Size()) + " boids " + ctx->swarm->KernelName() + " x" + std::to_string(ctx->swarm->Threads());
+ writeText(status, 10, 0, ctx);
  //std::cout << ctx->mouse.x << ", " << ctx->mouse.y << std::endl;
 }
 
-int main() {
+// --sprites n draws n more logos to compare batching, --offscreen renders
+// through the screen texture, --boids n flies a swarm of the core library on
+// --threads n workers (web_mt only). From the page: index.html?sprites=n&offscreen
+int main(int argc, char* argv[]) {
  context ctx;
+ for (int i = 1; i < argc; ++i) {
+  if (!strcmp(argv[i], "--sprites") && i + 1 < argc) ctx.extra.resize(std::max(0, atoi(argv[++i])));
+  else if (!strcmp(argv[i], "--offscreen")) ctx.offscreen = true;
+  else if (!strcmp(argv[i], "--boids") && i + 1 < argc) ctx.boids = atoi(argv[++i]);
+  else if (!strcmp(argv[i], "--threads") && i + 1 < argc) ctx.threads = std::max(1, atoi(argv[++i]));
+ }
+#if !defined(__EMSCRIPTEN_PTHREADS__)
+ ctx.threads = 1;
+#endif
  SDL_Init(SDL_INIT_VIDEO);
  ctx.width = 700, ctx.height = 500;
  SDL_Window *window;